@@ -0,0 +1,156 @@
+#include "./Adaptive_tessellator.h"
+
+#include <cmath>
+#include <cstdlib>
+
+void AdaptiveTessellator::tessellate(SurfacePatch &patch, AdaptiveMesh &mesh)
+{
+    this->patch = &patch;
+    this->mesh = &mesh;
+    this->lattice = 1 << (this->max_depth + 1);
+    // everything is cleared, not rebuilt, so a drag that keeps the mesh size stays off the heap
+    this->points.clear();
+    this->point_data.clear();
+    this->vertex_index.clear();
+    this->leaves.clear();
+    mesh.clear();
+
+    this->subdivide(0, 0, this->lattice, 0);
+
+    for (const Cell &leaf : this->leaves)
+    {
+        this->triangulate(leaf, this->boundary);
+    }
+}
+
+unsigned int AdaptiveTessellator::point(int x, int y)
+{
+    const unsigned int *found = this->points.find(key(x, y));
+    if (found != nullptr)
+    {
+        return *found;
+    }
+    unsigned int index = this->point_data.size() / 9;
+    this->point_data.resize(this->point_data.size() + 9);
+    float *p = &this->point_data[index * 9];
+    this->patch->evaluate_point(double(x) / this->lattice, double(y) / this->lattice, &p[0], &p[3], &p[6]);
+    this->points.insert(key(x, y), index);
+    return index;
+}
+
+unsigned int AdaptiveTessellator::vertex(int x, int y)
+{
+    const unsigned int *found = this->vertex_index.find(key(x, y));
+    if (found != nullptr)
+    {
+        return *found;
+    }
+    const float *p = this->point_values(this->point(x, y));
+    unsigned int index = this->mesh->num_vertices();
+    this->mesh->positions.insert(this->mesh->positions.end(), p, p + 3);
+    this->mesh->du.insert(this->mesh->du.end(), p + 3, p + 6);
+    this->mesh->dv.insert(this->mesh->dv.end(), p + 6, p + 9);
+    this->mesh->uv.push_back(float(x) / this->lattice);
+    this->mesh->uv.push_back(float(y) / this->lattice);
+    this->vertex_index.insert(key(x, y), index);
+    return index;
+}
+
+float AdaptiveTessellator::deviation(const Cell &cell, int x, int y, float s, float t)
+{
+    unsigned int ia = this->point(cell.x, cell.y);
+    unsigned int ib = this->point(cell.x + cell.size, cell.y);
+    unsigned int ic = this->point(cell.x, cell.y + cell.size);
+    unsigned int id = this->point(cell.x + cell.size, cell.y + cell.size);
+    unsigned int ip = this->point(x, y);
+    const float *a = this->point_values(ia), *b = this->point_values(ib), *c = this->point_values(ic);
+    const float *d = this->point_values(id), *p = this->point_values(ip);
+    float distance = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        float bilinear = (1 - s) * (1 - t) * a[k] + s * (1 - t) * b[k] + (1 - s) * t * c[k] + s * t * d[k];
+        distance += (p[k] - bilinear) * (p[k] - bilinear);
+    }
+    return std::sqrt(distance);
+}
+
+bool AdaptiveTessellator::flat_enough(const Cell &cell)
+{
+    int h = cell.size / 2;
+    return this->deviation(cell, cell.x + h, cell.y + h, 0.5f, 0.5f) <= this->tolerance &&
+           this->deviation(cell, cell.x + h, cell.y, 0.5f, 0.0f) <= this->tolerance &&
+           this->deviation(cell, cell.x + h, cell.y + cell.size, 0.5f, 1.0f) <= this->tolerance &&
+           this->deviation(cell, cell.x, cell.y + h, 0.0f, 0.5f) <= this->tolerance &&
+           this->deviation(cell, cell.x + cell.size, cell.y + h, 1.0f, 0.5f) <= this->tolerance;
+}
+
+void AdaptiveTessellator::subdivide(int x, int y, int size, int depth)
+{
+    Cell cell = {x, y, size};
+    if (depth >= this->max_depth || (depth >= this->min_depth && this->flat_enough(cell)))
+    {
+        this->leaves.push_back(cell);
+        // corners are registered now so that bigger neighbours see them on their edges
+        this->vertex(x, y);
+        this->vertex(x + size, y);
+        this->vertex(x, y + size);
+        this->vertex(x + size, y + size);
+        return;
+    }
+    int h = size / 2;
+    this->subdivide(x, y, h, depth + 1);
+    this->subdivide(x + h, y, h, depth + 1);
+    this->subdivide(x, y + h, h, depth + 1);
+    this->subdivide(x + h, y + h, h, depth + 1);
+}
+
+void AdaptiveTessellator::edge_vertices(int x0, int y0, int x1, int y1, std::vector<unsigned int> &out)
+{
+    if (std::abs(x1 - x0) + std::abs(y1 - y0) < 2)
+    {
+        return;
+    }
+    int mx = (x0 + x1) / 2, my = (y0 + y1) / 2;
+    const unsigned int *found = this->vertex_index.find(key(mx, my));
+    if (found == nullptr)
+    {
+        return;
+    }
+    unsigned int middle = *found;
+    this->edge_vertices(x0, y0, mx, my, out);
+    out.push_back(middle);
+    this->edge_vertices(mx, my, x1, y1, out);
+}
+
+void AdaptiveTessellator::triangulate(const Cell &leaf, std::vector<unsigned int> &boundary)
+{
+    int x0 = leaf.x, y0 = leaf.y, x1 = leaf.x + leaf.size, y1 = leaf.y + leaf.size;
+    // the corners of every leaf were registered by subdivide()
+    unsigned int a = *this->vertex_index.find(key(x0, y0));
+    unsigned int b = *this->vertex_index.find(key(x1, y0));
+    unsigned int c = *this->vertex_index.find(key(x1, y1));
+    unsigned int d = *this->vertex_index.find(key(x0, y1));
+
+    // counter-clockwise in (u, v): along v = y0, up u = x1, back along v = y1, down u = x0
+    boundary.clear();
+    boundary.push_back(a);
+    this->edge_vertices(x0, y0, x1, y0, boundary);
+    boundary.push_back(b);
+    this->edge_vertices(x1, y0, x1, y1, boundary);
+    boundary.push_back(c);
+    this->edge_vertices(x1, y1, x0, y1, boundary);
+    boundary.push_back(d);
+    this->edge_vertices(x0, y1, x0, y0, boundary);
+
+    std::vector<unsigned int> &indices = this->mesh->indices;
+    if (boundary.size() == 4)
+    {
+        indices.insert(indices.end(), {a, b, c, a, c, d});
+        return;
+    }
+    unsigned int centre = this->vertex(x0 + leaf.size / 2, y0 + leaf.size / 2);
+    for (size_t k = 0; k < boundary.size(); k++)
+    {
+        indices.insert(indices.end(), {centre, boundary[k], boundary[(k + 1) % boundary.size()]});
+    }
+}
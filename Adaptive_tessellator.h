@@ -0,0 +1,178 @@
+#ifndef ADAPTIVE_TESSELLATOR_H
+#define ADAPTIVE_TESSELLATOR_H
+
+#include "./Surface_patch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// triangle mesh of a patch, positions and derivatives in patch space, uv in [0, 1]
+struct AdaptiveMesh
+{
+    std::vector<float> positions;
+    std::vector<float> du, dv;
+    std::vector<float> uv;
+    std::vector<unsigned int> indices;
+
+    int num_vertices() const
+    {
+        return this->positions.size() / 3;
+    }
+
+    void clear()
+    {
+        this->positions.clear();
+        this->du.clear();
+        this->dv.clear();
+        this->uv.clear();
+        this->indices.clear();
+    }
+};
+
+// hash map from lattice points to indices, with open addressing in two flat arrays.
+// clear() keeps the slots, so a tessellation no bigger than an earlier one does not touch the
+// heap, the node per entry of a std::unordered_map would
+class LatticeMap
+{
+public:
+    LatticeMap() : count(0) {}
+
+    void clear()
+    {
+        std::fill(this->keys.begin(), this->keys.end(), EMPTY_KEY);
+        this->count = 0;
+    }
+
+    // nullptr if the key was never inserted
+    const unsigned int *find(uint64_t key) const
+    {
+        if (this->keys.empty())
+        {
+            return nullptr;
+        }
+        size_t s = this->slot(key);
+        return this->keys[s] == key ? &this->values[s] : nullptr;
+    }
+
+    void insert(uint64_t key, unsigned int value)
+    {
+        // at most half full, the probe sequences stay short
+        if (2 * (this->count + 1) > this->keys.size())
+        {
+            this->grow();
+        }
+        size_t s = this->slot(key);
+        if (this->keys[s] != key)
+        {
+            this->keys[s] = key;
+            this->count++;
+        }
+        this->values[s] = value;
+    }
+
+private:
+    // lattice coordinates are far below 2^32, so this key is never used
+    static const uint64_t EMPTY_KEY = ~uint64_t(0);
+
+    std::vector<uint64_t> keys;
+    std::vector<unsigned int> values;
+    size_t count;
+
+    // slot holding key, or the empty slot where it would go
+    size_t slot(uint64_t key) const
+    {
+        size_t mask = this->keys.size() - 1;
+        size_t s = (key * 0x9E3779B97F4A7C15ull) >> 20 & mask;
+        while (this->keys[s] != key && this->keys[s] != EMPTY_KEY)
+        {
+            s = (s + 1) & mask;
+        }
+        return s;
+    }
+
+    void grow()
+    {
+        std::vector<uint64_t> old_keys(std::max<size_t>(2 * this->keys.size(), 1024), EMPTY_KEY);
+        std::vector<unsigned int> old_values(old_keys.size());
+        old_keys.swap(this->keys);
+        old_values.swap(this->values);
+        this->count = 0;
+        for (size_t s = 0; s < old_keys.size(); s++)
+        {
+            if (old_keys[s] != EMPTY_KEY)
+            {
+                this->insert(old_keys[s], old_values[s]);
+            }
+        }
+    }
+};
+
+// splits the parameter domain of a patch as a quadtree until every cell is flat enough: the
+// surface at the centre and the edge midpoints of the cell may not be further than tolerance
+// from the bilinear interpolation of its corners (the chordal deviation). cells are addressed
+// on an integer lattice of 2^(max_depth + 1) steps per side, so every vertex the tree can
+// create has exact integer coordinates and is shared between neighbouring cells
+//
+// leaves whose edges carry vertices of smaller neighbours are triangulated as a fan around
+// their centre through all of those vertices, so there are no t-junctions and no cracks
+class AdaptiveTessellator
+{
+public:
+    float tolerance;
+    int min_depth, max_depth;
+
+    AdaptiveTessellator(float tolerance = 0.01f, int min_depth = 2, int max_depth = 8) : tolerance(tolerance), min_depth(min_depth), max_depth(max_depth) {}
+
+    void tessellate(SurfacePatch &patch, AdaptiveMesh &mesh);
+
+private:
+    struct Cell
+    {
+        int x, y, size;
+    };
+
+    SurfacePatch *patch;
+    AdaptiveMesh *mesh;
+    int lattice;
+    // surface points evaluated so far, including the ones only used for the flatness test:
+    // lattice position -> index of its position, du and dv in point_data, 9 floats each
+    LatticeMap points;
+    std::vector<float> point_data;
+    // lattice position -> index in the mesh of the vertices actually emitted
+    LatticeMap vertex_index;
+    std::vector<Cell> leaves;
+    std::vector<unsigned int> boundary;
+
+    static uint64_t key(int x, int y)
+    {
+        return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+    }
+
+    // index in point_data of position, du and dv at a lattice point, evaluated once. an index
+    // and not a pointer, point_data may move when the next point is added
+    unsigned int point(int x, int y);
+
+    const float *point_values(unsigned int index) const
+    {
+        return &this->point_data[index * 9];
+    }
+
+    unsigned int vertex(int x, int y);
+
+    // distance between the surface at lattice point (x, y) and the bilinear interpolation of
+    // the corners of the cell at (s, t) in [0, 1]^2
+    float deviation(const Cell &cell, int x, int y, float s, float t);
+
+    bool flat_enough(const Cell &cell);
+
+    void subdivide(int x, int y, int size, int depth);
+
+    // vertices strictly between (x0, y0) and (x1, y1) along an edge, in order. a neighbour can
+    // only have put a vertex at a quarter of the edge if it also split at its midpoint
+    void edge_vertices(int x0, int y0, int x1, int y1, std::vector<unsigned int> &out);
+
+    void triangulate(const Cell &leaf, std::vector<unsigned int> &boundary);
+};
+
+#endif
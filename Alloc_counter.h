@@ -0,0 +1,109 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// in debug builds (no -DNDEBUG) the global operator new, in its plain, array and aligned
+// forms, is replaced by one that counts calls, so hot loops can check that they do not touch
+// the heap. must only be included by one translation unit. in release builds
+// heap_allocations() always returns 0
+
+#ifndef NDEBUG
+
+unsigned long alloc_counter_allocations = 0;
+
+// every replaced form is kept out of line, inlined into its caller gcc would pair the
+// std::free() of a delete with the operator new that returned the pointer and warn about a
+// mismatch (-Wmismatched-new-delete)
+#define ALLOC_COUNTER_FUNCTION __attribute__((noinline))
+
+ALLOC_COUNTER_FUNCTION void *alloc_counter_allocate(std::size_t size, std::size_t alignment)
+{
+    alloc_counter_allocations++;
+    size = size ? size : 1;
+    // aligned_alloc() wants the size to be a multiple of the alignment
+    void *p = alignment <= alignof(std::max_align_t) ? std::malloc(size) : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+ALLOC_COUNTER_FUNCTION void *operator new(std::size_t size)
+{
+    return alloc_counter_allocate(size, 0);
+}
+
+ALLOC_COUNTER_FUNCTION void *operator new[](std::size_t size)
+{
+    return alloc_counter_allocate(size, 0);
+}
+
+ALLOC_COUNTER_FUNCTION void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return alloc_counter_allocate(size, std::size_t(alignment));
+}
+
+ALLOC_COUNTER_FUNCTION void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return alloc_counter_allocate(size, std::size_t(alignment));
+}
+
+ALLOC_COUNTER_FUNCTION void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+ALLOC_COUNTER_FUNCTION void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+ALLOC_COUNTER_FUNCTION void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+ALLOC_COUNTER_FUNCTION void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+ALLOC_COUNTER_FUNCTION void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+ALLOC_COUNTER_FUNCTION void operator delete[](void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+ALLOC_COUNTER_FUNCTION void operator delete(void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+ALLOC_COUNTER_FUNCTION void operator delete[](void *p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+unsigned long heap_allocations()
+{
+    return alloc_counter_allocations;
+}
+
+#else
+
+unsigned long heap_allocations()
+{
+    return 0;
+}
+
+#endif
+
+#endif
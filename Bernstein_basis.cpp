@@ -0,0 +1,96 @@
+#include "./Bernstein_basis.h"
+
+#include <cmath>
+
+float blend(int k, float mu, int n)
+{
+    int nn, kn, nkn;
+    float blend = 1;
+
+    nn = n;
+    kn = k;
+    nkn = n - k;
+
+    while (nn >= 1)
+    {
+        blend *= float(nn);
+        nn--;
+        if (kn > 1)
+        {
+            blend /= float(kn);
+            kn--;
+        }
+        if (nkn > 1)
+        {
+            blend /= float(nkn);
+            nkn--;
+        }
+    }
+    if (k > 0)
+    {
+        blend *= float(pow(mu, k));
+    }
+    if (n - k > 0)
+    {
+        blend *= float(pow(1 - mu, n - k));
+    }
+    return blend;
+}
+
+void bernstein_row(int n, double mu, double *out)
+{
+    double binomial = 1;
+    for (int k = 0; k <= n; k++)
+    {
+        out[k] = binomial * std::pow(mu, k) * std::pow(1 - mu, n - k);
+        binomial = binomial * (n - k) / (k + 1);
+    }
+}
+
+float blend_derivative(int k, float mu, int n)
+{
+    float lower = k > 0 ? blend(k - 1, mu, n - 1) : 0.0f;
+    float upper = k < n ? blend(k, mu, n - 1) : 0.0f;
+    return n * (lower - upper);
+}
+
+void bernstein_derivative_row(int n, double mu, double *out)
+{
+    if (n == 0)
+    {
+        out[0] = 0;
+        return;
+    }
+    // the degree n - 1 row goes into out first and is turned into the derivatives from the
+    // back, out[k] only needs entries k - 1 and k of it
+    bernstein_row(n - 1, mu, out);
+    out[n] = n * out[n - 1];
+    for (int k = n - 1; k > 0; k--)
+    {
+        out[k] = n * (out[k - 1] - out[k]);
+    }
+    out[0] = -n * out[0];
+}
+
+bool BasisTable::update(int degree, int resolution)
+{
+    if (degree == this->degree && resolution == this->resolution)
+    {
+        return false;
+    }
+    this->degree = degree;
+    this->resolution = resolution;
+    this->weights.assign(resolution * (degree + 1), 0.0f);
+    this->derivatives.assign(resolution * (degree + 1), 0.0f);
+
+    for (int i = 0; i < resolution; i++)
+    {
+        float mu = float(grid_parameter(i, resolution));
+        for (int k = 0; k <= degree; k++)
+        {
+            this->weights[i * (degree + 1) + k] = blend(k, mu, degree);
+            this->derivatives[i * (degree + 1) + k] = degree > 0 ? blend_derivative(k, mu, degree) : 0.0f;
+        }
+    }
+    return true;
+}
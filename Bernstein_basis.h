@@ -0,0 +1,60 @@
+#ifndef BERNSTEIN_BASIS_H
+#define BERNSTEIN_BASIS_H
+
+#include <vector>
+
+// parameter of sample i of a grid with resolution uniform samples over [0, 1], a single
+// sample sits at 0
+inline double grid_parameter(int i, int resolution)
+{
+    return resolution > 1 ? double(i) / (resolution - 1) : 0.0;
+}
+
+// k-th bernstein polynomial of degree n evaluated at mu
+float blend(int k, float mu, int n);
+
+// all n + 1 bernstein polynomials of degree n at mu in double precision
+void bernstein_row(int n, double mu, double *out);
+
+// derivative of the k-th bernstein polynomial of degree n at mu,
+// n * (B_{k-1,n-1}(mu) - B_{k,n-1}(mu))
+float blend_derivative(int k, float mu, int n);
+
+// derivatives of all n + 1 bernstein polynomials of degree n at mu in double precision
+void bernstein_derivative_row(int n, double mu, double *out);
+
+// bernstein weights of one parameter direction sampled at a uniform resolution,
+// stored as a (resolution x (degree + 1)) row-major matrix so that evaluating a
+// surface becomes two small dense matrix products instead of calling blend()
+// in the innermost loop. derivatives holds the weights of the derivative in the
+// same layout
+struct BasisTable
+{
+    int degree;
+    int resolution;
+    std::vector<float> weights;
+    std::vector<float> derivatives;
+
+    BasisTable() : degree(-1), resolution(0) {}
+
+    // rebuilds the table only when the degree or the resolution changed,
+    // returns true if it did
+    bool update(int degree, int resolution);
+
+    const float *row(int i) const
+    {
+        return &this->weights[i * (this->degree + 1)];
+    }
+
+    float at(int i, int k) const
+    {
+        return this->weights[i * (this->degree + 1) + k];
+    }
+
+    float derivative_at(int i, int k) const
+    {
+        return this->derivatives[i * (this->degree + 1) + k];
+    }
+};
+
+#endif
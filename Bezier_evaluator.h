@@ -0,0 +1,168 @@
+#ifndef BEZIER_EVALUATOR_H
+#define BEZIER_EVALUATOR_H
+
+// bezier evaluators with the degree as template parameters, so the loops over the control
+// net have compile-time trip counts and can be fully unrolled and vectorized. degrees
+// 1 to MAX_SPECIALIZED_DEGREE are instantiated, anything else uses the runtime loops of
+// the *_generic kernels
+
+#define MAX_SPECIALIZED_DEGREE 5
+
+// a (res_i x res_j) grid is evaluated from precomputed basis tables (see BasisTable) in two
+// passes, partial[ki][j] = sum_kj cp[ki][kj] * basis_j[j][kj] for columns j0..j1, then
+// out[i][j] = sum_ki basis_i[i][ki] * partial[ki][j] over the tile i0..i1 x j0..j1. the
+// degree arguments are ignored by the specialized kernels
+typedef void (*ContractJ)(const float *cp, const float *basis_j, int ni, int nj, int res_j, int j0, int j1, float *partial);
+typedef void (*ContractI)(const float *basis_i, int ni, int res_j, const float *partial, int i0, int i1, int j0, int j1, float *out);
+
+struct GridKernels
+{
+    ContractJ contract_j;
+    ContractI contract_i;
+};
+
+inline void contract_j_generic(const float *cp, const float *basis_j, int ni, int nj, int res_j, int j0, int j1, float *partial)
+{
+    for (int ki = 0; ki <= ni; ki++)
+    {
+        const float *cp_row = cp + ki * (nj + 1) * 3;
+        float *partial_row = partial + ki * res_j * 3;
+        for (int j = j0; j < j1; j++)
+        {
+            const float *bj = basis_j + j * (nj + 1);
+            float x = 0, y = 0, z = 0;
+            for (int kj = 0; kj <= nj; kj++)
+            {
+                x += cp_row[kj * 3 + 0] * bj[kj];
+                y += cp_row[kj * 3 + 1] * bj[kj];
+                z += cp_row[kj * 3 + 2] * bj[kj];
+            }
+            partial_row[j * 3 + 0] = x;
+            partial_row[j * 3 + 1] = y;
+            partial_row[j * 3 + 2] = z;
+        }
+    }
+}
+
+// rows of the tile are contiguous, so the inner loop is a single axpy over its 3 * (j1 - j0) floats
+inline void contract_i_generic(const float *basis_i, int ni, int res_j, const float *partial, int i0, int i1, int j0, int j1, float *out)
+{
+    for (int i = i0; i < i1; i++)
+    {
+        const float *bi = basis_i + i * (ni + 1);
+        float *out_row = out + i * res_j * 3;
+        for (int j = j0 * 3; j < j1 * 3; j++)
+        {
+            out_row[j] = 0;
+        }
+        for (int ki = 0; ki <= ni; ki++)
+        {
+            float w = bi[ki];
+            const float *partial_row = partial + ki * res_j * 3;
+            for (int j = j0 * 3; j < j1 * 3; j++)
+            {
+                out_row[j] += w * partial_row[j];
+            }
+        }
+    }
+}
+
+template <int NI, int NJ>
+void contract_j(const float *cp, const float *basis_j, int, int, int res_j, int j0, int j1, float *partial)
+{
+    for (int ki = 0; ki <= NI; ki++)
+    {
+        const float *cp_row = cp + ki * (NJ + 1) * 3;
+        float *partial_row = partial + ki * res_j * 3;
+        for (int j = j0; j < j1; j++)
+        {
+            const float *bj = basis_j + j * (NJ + 1);
+            float x = 0, y = 0, z = 0;
+            for (int kj = 0; kj <= NJ; kj++)
+            {
+                x += cp_row[kj * 3 + 0] * bj[kj];
+                y += cp_row[kj * 3 + 1] * bj[kj];
+                z += cp_row[kj * 3 + 2] * bj[kj];
+            }
+            partial_row[j * 3 + 0] = x;
+            partial_row[j * 3 + 1] = y;
+            partial_row[j * 3 + 2] = z;
+        }
+    }
+}
+
+// the ki loop is unrolled, so every output float is accumulated in a register
+template <int NI>
+void contract_i(const float *basis_i, int, int res_j, const float *partial, int i0, int i1, int j0, int j1, float *out)
+{
+    const float *partial_rows[NI + 1];
+    for (int ki = 0; ki <= NI; ki++)
+    {
+        partial_rows[ki] = partial + ki * res_j * 3;
+    }
+    for (int i = i0; i < i1; i++)
+    {
+        float bi[NI + 1];
+        for (int ki = 0; ki <= NI; ki++)
+        {
+            bi[ki] = basis_i[i * (NI + 1) + ki];
+        }
+        float *__restrict out_row = out + i * res_j * 3;
+        for (int j = j0 * 3; j < j1 * 3; j++)
+        {
+            float acc = 0;
+            for (int ki = 0; ki <= NI; ki++)
+            {
+                acc += bi[ki] * partial_rows[ki][j];
+            }
+            out_row[j] = acc;
+        }
+    }
+}
+
+template <int NI>
+ContractJ specialized_contract_j(int nj)
+{
+    switch (nj)
+    {
+    case 1:
+        return contract_j<NI, 1>;
+    case 2:
+        return contract_j<NI, 2>;
+    case 3:
+        return contract_j<NI, 3>;
+    case 4:
+        return contract_j<NI, 4>;
+    case 5:
+        return contract_j<NI, 5>;
+    default:
+        return nullptr;
+    }
+}
+
+// the kernels for degree (ni, nj), specialized ones if requested and both degrees have one
+inline GridKernels grid_kernels(int ni, int nj, bool specialized)
+{
+    GridKernels generic = {contract_j_generic, contract_i_generic};
+    if (!specialized || nj < 1 || nj > MAX_SPECIALIZED_DEGREE)
+    {
+        return generic;
+    }
+    switch (ni)
+    {
+    case 1:
+        return {specialized_contract_j<1>(nj), contract_i<1>};
+    case 2:
+        return {specialized_contract_j<2>(nj), contract_i<2>};
+    case 3:
+        return {specialized_contract_j<3>(nj), contract_i<3>};
+    case 4:
+        return {specialized_contract_j<4>(nj), contract_i<4>};
+    case 5:
+        return {specialized_contract_j<5>(nj), contract_i<5>};
+    default:
+        return generic;
+    }
+}
+
+#endif
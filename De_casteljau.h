@@ -0,0 +1,55 @@
+#ifndef DE_CASTELJAU_H
+#define DE_CASTELJAU_H
+
+// de casteljau evaluation only takes convex combinations of control points, there are no
+// binomial coefficients or powers that overflow or underflow, so it stays accurate for
+// high degrees at the cost of O(n^2) operations per curve point. Real is float or double,
+// the precision every intermediate point is accumulated in
+
+// the first steps of the reduction of the degree n curve with the n + 1 xyz points p, in
+// place. afterwards p holds the n + 1 - steps points of that level
+template <typename Real>
+inline void de_casteljau_steps(Real *p, int n, Real t, int steps)
+{
+    Real s = 1 - t;
+    for (int r = 1; r <= steps; r++)
+    {
+        for (int k = 0; k <= n - r; k++)
+        {
+            p[k * 3 + 0] = s * p[k * 3 + 0] + t * p[(k + 1) * 3 + 0];
+            p[k * 3 + 1] = s * p[k * 3 + 1] + t * p[(k + 1) * 3 + 1];
+            p[k * 3 + 2] = s * p[k * 3 + 2] + t * p[(k + 1) * 3 + 2];
+        }
+    }
+}
+
+// point at t of the degree n curve with the n + 1 xyz points p, p is used as scratch space
+template <typename Real>
+inline void de_casteljau(Real *p, int n, Real t, Real *out)
+{
+    de_casteljau_steps(p, n, t, n);
+    out[0] = p[0];
+    out[1] = p[1];
+    out[2] = p[2];
+}
+
+// point and derivative at t. the last two points of the hull span the tangent, the
+// derivative is n times their difference
+template <typename Real>
+inline void de_casteljau(Real *p, int n, Real t, Real *out, Real *tangent)
+{
+    if (n == 0)
+    {
+        de_casteljau(p, n, t, out);
+        tangent[0] = tangent[1] = tangent[2] = 0;
+        return;
+    }
+    de_casteljau_steps(p, n, t, n - 1);
+    for (int c = 0; c < 3; c++)
+    {
+        tangent[c] = n * (p[3 + c] - p[c]);
+        out[c] = (1 - t) * p[c] + t * p[3 + c];
+    }
+}
+
+#endif
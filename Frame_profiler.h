@@ -0,0 +1,187 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// frames the rolling statistics cover
+#define PROFILE_HISTORY 300
+
+struct ZoneStats
+{
+    // milliseconds per frame
+    float min, avg, p99;
+};
+
+// time spent per frame in named zones, in milliseconds, kept for the last PROFILE_HISTORY
+// frames. a zone entered several times in a frame adds up. the history and the scratch space
+// of the statistics are allocated up front, so zones may sit in the drag path that has to stay
+// off the heap. besides the named zones the profiler times the whole frame as zone
+// names.size(), begin_frame() to end_frame()
+class FrameProfiler
+{
+public:
+    bool enabled;
+    std::vector<const char *> names;
+
+    FrameProfiler(const std::vector<const char *> &names) : enabled(false), names(names), frames(0), csv(nullptr)
+    {
+        this->current.assign(names.size() + 1, 0.0f);
+        this->history.assign((names.size() + 1) * PROFILE_HISTORY, 0.0f);
+        this->scratch.reserve(PROFILE_HISTORY);
+    }
+
+    FrameProfiler(const FrameProfiler &) = delete;
+    FrameProfiler &operator=(const FrameProfiler &) = delete;
+
+    ~FrameProfiler()
+    {
+        if (this->csv != nullptr)
+        {
+            fclose(this->csv);
+        }
+    }
+
+    int num_zones() const
+    {
+        return this->names.size() + 1;
+    }
+
+    const char *zone_name(int zone) const
+    {
+        return zone < (int)this->names.size() ? this->names[zone] : "frame";
+    }
+
+    // every finished frame is also written to path as one csv row of all zones
+    bool open_csv(const char *path)
+    {
+        this->csv = fopen(path, "w");
+        if (this->csv == nullptr)
+        {
+            return false;
+        }
+        fprintf(this->csv, "frame");
+        for (int zone = 0; zone < this->num_zones(); zone++)
+        {
+            fprintf(this->csv, ",%s_ms", this->zone_name(zone));
+        }
+        fprintf(this->csv, "\n");
+        return true;
+    }
+
+    void begin_frame()
+    {
+        if (!this->enabled)
+        {
+            return;
+        }
+        std::fill(this->current.begin(), this->current.end(), 0.0f);
+        this->frame_start = std::chrono::steady_clock::now();
+    }
+
+    void add(int zone, float ms)
+    {
+        this->current[zone] += ms;
+    }
+
+    void end_frame()
+    {
+        if (!this->enabled)
+        {
+            return;
+        }
+        int frame = this->names.size();
+        this->current[frame] = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - this->frame_start).count();
+
+        int slot = this->frames % PROFILE_HISTORY;
+        for (int zone = 0; zone < this->num_zones(); zone++)
+        {
+            this->history[zone * PROFILE_HISTORY + slot] = this->current[zone];
+        }
+        if (this->csv != nullptr)
+        {
+            fprintf(this->csv, "%ld", this->frames);
+            for (float ms : this->current)
+            {
+                fprintf(this->csv, ",%.4f", ms);
+            }
+            fprintf(this->csv, "\n");
+        }
+        this->frames++;
+    }
+
+    // over the frames still in the history
+    ZoneStats stats(int zone)
+    {
+        int count = std::min(this->frames, (long)PROFILE_HISTORY);
+        if (count == 0)
+        {
+            return {0, 0, 0};
+        }
+        const float *samples = &this->history[zone * PROFILE_HISTORY];
+        this->scratch.assign(samples, samples + count);
+        float sum = 0;
+        for (float ms : this->scratch)
+        {
+            sum += ms;
+        }
+        auto p99 = this->scratch.begin() + (count * 99 + 99) / 100 - 1;
+        std::nth_element(this->scratch.begin(), p99, this->scratch.end());
+        ZoneStats stats = {*std::min_element(this->scratch.begin(), this->scratch.end()), sum / count, *p99};
+        return stats;
+    }
+
+    // "name min/avg/p99" of every zone, in milliseconds
+    std::string summary()
+    {
+        std::string text;
+        char zone_text[64];
+        for (int zone = 0; zone < this->num_zones(); zone++)
+        {
+            ZoneStats s = this->stats(zone);
+            snprintf(zone_text, sizeof(zone_text), "%s%s %.2f/%.2f/%.2f", zone > 0 ? "  " : "", this->zone_name(zone), s.min, s.avg, s.p99);
+            text += zone_text;
+        }
+        return text;
+    }
+
+private:
+    long frames;
+    std::vector<float> current;
+    // PROFILE_HISTORY frames per zone, a ring indexed by frames % PROFILE_HISTORY
+    std::vector<float> history;
+    std::vector<float> scratch;
+    std::chrono::steady_clock::time_point frame_start;
+    FILE *csv;
+};
+
+// adds the time until the end of the enclosing scope to a zone of the profiler
+class ProfileZone
+{
+public:
+    ProfileZone(FrameProfiler &profiler, int zone) : profiler(profiler), zone(zone)
+    {
+        if (profiler.enabled)
+        {
+            this->start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ProfileZone()
+    {
+        if (this->profiler.enabled)
+        {
+            this->profiler.add(this->zone, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - this->start).count());
+        }
+    }
+
+private:
+    FrameProfiler &profiler;
+    int zone;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include "./glad.h"
+
+#include <cstring>
+
+// glad is generated for OpenGL 3.3 core. the few newer entry points and enums the optional
+// render paths use are declared here and loaded by load_gl_extensions() once a context is
+// current, a pointer stays nullptr when the context does not provide the function. the
+// pointers are inline variables, every translation unit including this shares one set
+
+// 4.0 tessellation
+#define GL_PATCHES 0x000E
+#define GL_PATCH_VERTICES 0x8E72
+// 4.2 / 4.3 compute shaders and shader storage buffers
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+// 4.4 / ARB_buffer_storage immutable storage and persistent mapping
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+
+typedef void(APIENTRYP PFNGLPATCHPARAMETERIPROC)(GLenum pname, GLint value);
+typedef void(APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z);
+typedef void(APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void(APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+inline PFNGLPATCHPARAMETERIPROC glPatchParameteri_ = nullptr;
+inline PFNGLDISPATCHCOMPUTEPROC glDispatchCompute_ = nullptr;
+inline PFNGLMEMORYBARRIERPROC glMemoryBarrier_ = nullptr;
+inline PFNGLBUFFERSTORAGEPROC glBufferStorage_ = nullptr;
+
+// true if the current context is at least version major.minor or lists the extension
+inline bool gl_supports(int major, int minor, const char *extension)
+{
+    GLint context_major = 0, context_minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+    glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+    if (context_major > major || (context_major == major && context_minor >= minor))
+    {
+        return true;
+    }
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    for (GLint e = 0; e < num_extensions; e++)
+    {
+        if (strcmp((const char *)glGetStringi(GL_EXTENSIONS, e), extension) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void load_gl_extensions(GLADloadproc load)
+{
+    // some loaders hand out pointers for functions the driver does not implement, so a
+    // pointer is only loaded when the context actually supports its feature
+    if (gl_supports(4, 0, "GL_ARB_tessellation_shader"))
+    {
+        glPatchParameteri_ = (PFNGLPATCHPARAMETERIPROC)load("glPatchParameteri");
+    }
+    if (gl_supports(4, 3, "GL_ARB_compute_shader"))
+    {
+        glDispatchCompute_ = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+        glMemoryBarrier_ = (PFNGLMEMORYBARRIERPROC)load("glMemoryBarrier");
+    }
+    if (gl_supports(4, 4, "GL_ARB_buffer_storage"))
+    {
+        glBufferStorage_ = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+    }
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "./glad.h"
+#include "./Frame_profiler.h"
+
+#include <vector>
+
+// frames between issuing a query and reading its result, by then the gpu has long finished
+// that frame and reading the result does not wait for it
+#define GPU_TIMER_LATENCY 4
+
+// GL_TIME_ELAPSED queries around the passes of a frame, GPU_TIMER_LATENCY frames of queries
+// used as a ring. the results of a frame are collected when its slot comes around again and
+// only if the query reports them available, a late result is dropped instead of stalling the
+// cpu. each pass is reported to a zone of a FrameProfiler, so gpu times appear next to the cpu
+// times, GPU_TIMER_LATENCY frames after the frame they measured. elapsed time queries are core
+// in OpenGL 3.3 and software rasterizers like llvmpipe implement them as well
+//
+// queries of one target can not nest, so the passes of a frame must not overlap
+class GpuTimer
+{
+public:
+    // results that were not available in time
+    long dropped;
+
+    GpuTimer() : dropped(0), profiler(nullptr), frame(0) {}
+
+    // pass p is reported to zone zones[p] of profiler
+    void create(FrameProfiler &profiler, const std::vector<int> &zones)
+    {
+        this->profiler = &profiler;
+        this->zones = zones;
+        this->queries.assign(GPU_TIMER_LATENCY * zones.size(), 0);
+        this->issued.assign(GPU_TIMER_LATENCY * zones.size(), false);
+        glGenQueries(this->queries.size(), this->queries.data());
+    }
+
+    void destroy()
+    {
+        if (!this->queries.empty())
+        {
+            glDeleteQueries(this->queries.size(), this->queries.data());
+            this->queries.clear();
+        }
+        this->profiler = nullptr;
+    }
+
+    bool enabled() const
+    {
+        return this->profiler != nullptr && this->profiler->enabled;
+    }
+
+    // collects the results of the frame whose queries this frame reuses, call it after the
+    // profiler's begin_frame()
+    void begin_frame()
+    {
+        if (!this->enabled())
+        {
+            return;
+        }
+        for (size_t pass = 0; pass < this->zones.size(); pass++)
+        {
+            int q = this->query_index(pass);
+            if (!this->issued[q])
+            {
+                continue;
+            }
+            this->issued[q] = false;
+            GLint available = 0;
+            glGetQueryObjectiv(this->queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+            {
+                this->dropped++;
+                continue;
+            }
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(this->queries[q], GL_QUERY_RESULT, &ns);
+            this->profiler->add(this->zones[pass], ns * 1e-6f);
+        }
+    }
+
+    void begin(int pass)
+    {
+        if (this->enabled())
+        {
+            glBeginQuery(GL_TIME_ELAPSED, this->queries[this->query_index(pass)]);
+        }
+    }
+
+    void end(int pass)
+    {
+        if (this->enabled())
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+            this->issued[this->query_index(pass)] = true;
+        }
+    }
+
+    void end_frame()
+    {
+        this->frame++;
+    }
+
+private:
+    FrameProfiler *profiler;
+    std::vector<int> zones;
+    std::vector<GLuint> queries;
+    // the query holds a result that was not read yet
+    std::vector<bool> issued;
+    long frame;
+
+    int query_index(int pass) const
+    {
+        return (this->frame % GPU_TIMER_LATENCY) * this->zones.size() + pass;
+    }
+};
+
+#endif
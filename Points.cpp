@@ -1,14 +1,22 @@
 #include <glm/glm.hpp>
 #include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include "./glad.h"
+#include "./Streaming_buffer.h"
+#include "./Vertex_format.h"
 
 using namespace std;
 
 #define INFO_PER_POINT 8
-#define MAX_NO_POINTS 100000
+// the pool starts with room for this many points and at least doubles whenever it runs out
+#define INITIAL_POINT_CAPACITY 1024
 
 struct Points
 {
+    // a point as it is handed to add_point(), the pool stores its geometry and its
+    // bookkeeping in separate arrays
     struct Point
     {
         glm::vec3 position;
@@ -38,99 +46,189 @@ struct Points
         }
 
         Point(glm::vec3 pos, glm::vec3 normal, glm::vec2 tex, bool is_CP = false) : position(pos), normal(normal), tex_coord(tex), is_CP(is_CP), i_in_CP_array(-1), j_in_CP_array(-1) {}
+    };
 
-        float *get_properties_as_array()
+    // hot part of a point: read by picking, written by the tessellator, serialized every
+    // flush. it is exactly the INFO_PER_POINT float vertex format, so a span of the array
+    // is uploaded as is when the buffer holds float vertices
+    struct Vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 tex_coord;
+
+        // the INFO_PER_POINT floats of the vertex
+        const float *get_properties_as_array() const
         {
-            float *properties_array = new float[INFO_PER_POINT];
-            properties_array[0] = this->position[0];
-            properties_array[1] = this->position[1];
-            properties_array[2] = this->position[2];
-            properties_array[3] = this->normal[0];
-            properties_array[4] = this->normal[1];
-            properties_array[5] = this->normal[2];
-            properties_array[6] = this->tex_coord[0];
-            properties_array[7] = this->tex_coord[1];
-
-            return properties_array;
+            return &this->position[0];
         }
     };
 
-    static Point *points;
+    static_assert(sizeof(Vertex) == INFO_PER_POINT * sizeof(float), "a vertex is INFO_PER_POINT floats");
+    static_assert(offsetof(Vertex, normal) == 3 * sizeof(float), "normal must follow position");
+    static_assert(offsetof(Vertex, tex_coord) == 6 * sizeof(float), "tex_coord must follow normal");
+
+    // cold part of a point: only looked at once a point is picked
+    struct PointInfo
+    {
+        int index;
+        bool is_CP;
+        int i_in_CP_array, j_in_CP_array;
+    };
+
+    vector<Vertex> geometry;
+    vector<PointInfo> metadata;
     static int num_points;
     static vector<int> info_length_per_point;
     float primitive_size;
+    // layout of the vertices in the buffer, chosen before the first upload
+    VertexFormat format;
+    vector<unsigned char> staging;
+    // span of points modified since the last flush_to_buffer()
+    int dirty_first, dirty_last;
+    // glBufferSubData calls issued since the counter was last reset
+    int buffer_uploads;
+
+    Points() : primitive_size(sizeof(float)), format(VERTEX_FLOAT), dirty_first(0), dirty_last(0), buffer_uploads(0)
+    {
+        this->reserve(INITIAL_POINT_CAPACITY);
+    }
+
+    // points the pool holds without growing, the vertex buffer is kept at least this large
+    int capacity() const
+    {
+        return this->geometry.size();
+    }
+
+    // makes room for count points. growth is geometric so that adding points one by one
+    // stays amortized constant, callers that know their size up front reserve it once
+    void reserve(int count)
+    {
+        if (count <= this->capacity())
+        {
+            return;
+        }
+        int grown = max(count, 2 * this->capacity());
+        this->geometry.resize(grown);
+        this->metadata.resize(grown);
+    }
 
-    Points() : primitive_size(sizeof(float)) {}
+    // bytes of one vertex in the buffer
+    size_t vertex_size() const
+    {
+        return ::vertex_size(this->format);
+    }
 
-    void add_vertices_to_buffer(unsigned int &VBO, float offset, float size, float *new_vertices)
+    // offset and size in bytes, exact for buffers of any size unlike a float
+    void add_vertices_to_buffer(unsigned int &VBO, GLintptr offset, GLsizeiptr size, const void *new_vertices)
     {
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferSubData(GL_ARRAY_BUFFER, offset, size, new_vertices);
+        this->buffer_uploads++;
     }
 
-    void modify_point_position_in_buffer(unsigned int &VBO, float offset, float size, float *new_pos)
+    // points are only written to the cpu side pool here, flush_to_buffer() uploads them
+    void add_point(const Point &point)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, offset, size, new_pos);
+        this->reserve(this->num_points + 1);
+        int index = this->num_points++;
+        this->geometry[index] = {point.position, point.normal, point.tex_coord};
+        this->metadata[index] = {index, point.is_CP, point.is_CP ? point.i_in_CP_array : -1, point.is_CP ? point.j_in_CP_array : -1};
+        this->mark_dirty(index, 1);
     }
 
-    void add_point(unsigned int &VBO, Point point)
+    void mark_dirty(int first, int count)
     {
-        point.index = this->num_points;
-        this->points[this->num_points++] = point;
-        this->write_point_to_buffer(VBO, point);
+        if (this->dirty_last <= this->dirty_first)
+        {
+            this->dirty_first = first;
+            this->dirty_last = first + count;
+            return;
+        }
+        this->dirty_first = min(this->dirty_first, first);
+        this->dirty_last = max(this->dirty_last, first + count);
     }
 
-    float *get_all_points_properties_as_array()
+    // uploads everything modified since the last flush with a single call
+    void flush_to_buffer(unsigned int &VBO)
     {
-        float *properties_array = new float[INFO_PER_POINT * this->num_points];
+        int last = min(this->dirty_last, this->num_points);
+        if (last > this->dirty_first)
+        {
+            this->write_points_to_buffer(VBO, this->dirty_first, last - this->dirty_first);
+        }
+        this->dirty_first = this->dirty_last = 0;
+    }
 
-        for (int i = 0; i < this->num_points; i++)
+    // hands everything modified since the last flush to the streaming buffer, which then
+    // copies whatever its next segment is missing with a single write
+    void flush_to_stream(StreamingBuffer &stream)
+    {
+        size_t point_bytes = this->vertex_size();
+        int last = min(this->dirty_last, this->num_points);
+        if (last > this->dirty_first)
         {
-            Point curr_point = this->points[i];
-            float *point_properties = curr_point.get_properties_as_array();
+            stream.invalidate(this->dirty_first * point_bytes, last * point_bytes);
+        }
+        this->dirty_first = this->dirty_last = 0;
 
-            for (int j = 0; j < INFO_PER_POINT; j++)
-            {
-                properties_array[i * INFO_PER_POINT + j] = point_properties[j];
-            }
+        size_t first_byte, last_byte;
+        if (stream.next_segment(this->num_points * point_bytes, first_byte, last_byte))
+        {
+            const unsigned char *properties_array = this->serialize_points(first_byte / point_bytes, (last_byte - first_byte) / point_bytes);
+            stream.write(first_byte, last_byte - first_byte, properties_array);
+            this->buffer_uploads++;
         }
-        return properties_array;
     }
 
-    void write_all_points_to_buffer(unsigned int &VBO)
+    // points [first, first + count) in the vertex format. float vertices are the pool itself,
+    // other formats are encoded into the staging array, which only ever grows
+    const unsigned char *serialize_points(int first, int count)
     {
-        for (int i = 0; i < this->num_points; i++)
+        if (this->format == VERTEX_FLOAT)
         {
-            this->write_point_to_buffer(VBO, this->points[i]);
+            return (const unsigned char *)&this->geometry[first];
         }
+        size_t size = this->vertex_size();
+        if (this->staging.size() < size * count)
+        {
+            this->staging.resize(size * count);
+        }
+        unsigned char *dst = this->staging.data();
+        for (int i = 0; i < count; i++)
+        {
+            encode_vertex(this->format, this->geometry[first + i].get_properties_as_array(), dst + i * size);
+        }
+        return dst;
     }
 
-    void write_point_to_buffer(unsigned int &VBO, Point point)
+    const unsigned char *get_all_points_properties_as_array()
     {
-        float *properties_array = new float[INFO_PER_POINT];
-        float *point_properties = point.get_properties_as_array();
+        return this->serialize_points(0, this->num_points);
+    }
 
-        for (int i = 0; i < INFO_PER_POINT; i++)
-        {
-            properties_array[i] = point_properties[i];
-        }
-        float offset = (this->num_points - 1) * this->primitive_size * INFO_PER_POINT;
-        float size = this->primitive_size * INFO_PER_POINT;
-        this->add_vertices_to_buffer(VBO, offset, size, properties_array);
+    void write_all_points_to_buffer(unsigned int &VBO)
+    {
+        this->mark_dirty(0, this->num_points);
+        this->flush_to_buffer(VBO);
+    }
+
+    // uploads points [first, first + count) with a single glBufferSubData call
+    void write_points_to_buffer(unsigned int &VBO, int first, int count)
+    {
+        const unsigned char *properties_array = this->serialize_points(first, count);
+        size_t offset = size_t(first) * this->vertex_size();
+        size_t size = size_t(count) * this->vertex_size();
+        this->add_vertices_to_buffer(VBO, GLintptr(offset), GLsizeiptr(size), properties_array);
     }
 
-    void modify_point_position_in_buffer(unsigned int &VBO, int point_index, glm::vec3 new_position)
+    void modify_point_position(int point_index, glm::vec3 new_position)
     {
-        this->points[point_index].position = new_position;
-        float offset = point_index * INFO_PER_POINT * this->primitive_size;
-        float new_pos[3] = {new_position.x, new_position.y, new_position.z};
-        float size = sizeof(new_pos);
-        this->modify_point_position_in_buffer(VBO, offset, size, new_pos);
+        this->geometry[point_index].position = new_position;
+        this->mark_dirty(point_index, 1);
     }
 
 } points;
 
-Points::Point *Points::points = new Points::Point[MAX_NO_POINTS];
 int Points::num_points = 0;
 vector<int> Points::info_length_per_point = {3, 3, 2};
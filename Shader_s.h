@@ -9,18 +9,33 @@
 #include <sstream>
 #include <iostream>
 
+// tessellation stages are core since OpenGL 4.0, the loader only covers 3.3
+#ifndef GL_TESS_CONTROL_SHADER
+#define GL_TESS_EVALUATION_SHADER 0x8E87
+#define GL_TESS_CONTROL_SHADER 0x8E88
+#endif
+// and compute shaders since 4.3
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly, the tessellation stages need
+    // an OpenGL 4.0 context and are only compiled when both paths are given
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const char* tessControlPath = nullptr, const char* tessEvaluationPath = nullptr)
     {
+        bool tessellation = tessControlPath != nullptr && tessEvaluationPath != nullptr;
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
+        std::string tessControlCode;
+        std::string tessEvaluationCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -52,6 +67,12 @@ public:
                 gShaderFile.close();
                 geometryCode = gShaderStream.str();
             }
+            // same for the tessellation control and evaluation shaders
+            if(tessellation)
+            {
+                tessControlCode = readFile(tessControlPath);
+                tessEvaluationCode = readFile(tessEvaluationPath);
+            }
         }
         catch (std::ifstream::failure& e)
         {
@@ -72,7 +93,7 @@ public:
         glCompileShader(fragment);
         checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
+        unsigned int geometry = 0;
         if(geometryPath != nullptr)
         {
             const char * gShaderCode = geometryCode.c_str();
@@ -81,12 +102,32 @@ public:
             glCompileShader(geometry);
             checkCompileErrors(geometry, "GEOMETRY");
         }
+        // if tessellation shaders are given, compile both stages
+        unsigned int tessControl = 0, tessEvaluation = 0;
+        if(tessellation)
+        {
+            const char * tcShaderCode = tessControlCode.c_str();
+            tessControl = glCreateShader(GL_TESS_CONTROL_SHADER);
+            glShaderSource(tessControl, 1, &tcShaderCode, NULL);
+            glCompileShader(tessControl);
+            checkCompileErrors(tessControl, "TESS_CONTROL");
+            const char * teShaderCode = tessEvaluationCode.c_str();
+            tessEvaluation = glCreateShader(GL_TESS_EVALUATION_SHADER);
+            glShaderSource(tessEvaluation, 1, &teShaderCode, NULL);
+            glCompileShader(tessEvaluation);
+            checkCompileErrors(tessEvaluation, "TESS_EVALUATION");
+        }
         // shader Program
         ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         if(geometryPath != nullptr)
             glAttachShader(ID, geometry);
+        if(tessellation)
+        {
+            glAttachShader(ID, tessControl);
+            glAttachShader(ID, tessEvaluation);
+        }
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
@@ -94,8 +135,37 @@ public:
         glDeleteShader(fragment);
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
+        if(tessellation)
+        {
+            glDeleteShader(tessControl);
+            glDeleteShader(tessEvaluation);
+        }
 
     }
+    // constructor for a compute program, needs an OpenGL 4.3 context
+    // ------------------------------------------------------------------------
+    Shader(const char* computePath)
+    {
+        std::string computeCode;
+        try
+        {
+            computeCode = readFile(computePath);
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+        }
+        const char* cShaderCode = computeCode.c_str();
+        unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &cShaderCode, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        glDeleteShader(compute);
+    }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
@@ -162,6 +232,18 @@ public:
     }
 
 private:
+    // whole content of a shader file, throws std::ifstream::failure like the reads above
+    // ------------------------------------------------------------------------
+    std::string readFile(const char* path)
+    {
+        std::ifstream file;
+        file.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        file.open(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        file.close();
+        return stream.str();
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,362 @@
+#ifndef SIMD_EVALUATOR_H
+#define SIMD_EVALUATOR_H
+
+// batch evaluation of a bezier patch at arbitrary (u, v) samples, several samples per
+// instruction: 8 with avx2 + fma, 4 with sse2 or neon. the control net is kept as a
+// structure of arrays so every control point is a broadcast from three flat arrays.
+// the kernel is picked once at runtime from what the cpu supports, evaluate_points_scalar()
+// is the reference the vector kernels are compared against
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_EVALUATOR_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_EVALUATOR_NEON
+#endif
+
+// bernstein weights are kept on the stack, higher degrees have to use another evaluator
+#define MAX_BATCH_DEGREE 31
+
+struct ControlNetSoA
+{
+    int ni, nj;
+    std::vector<float> x, y, z;
+    std::vector<float> binomial_i, binomial_j;
+
+    ControlNetSoA() : ni(0), nj(0) {}
+
+    // xyz is the (ni + 1) x (nj + 1) interleaved control net used by SurfacePatch
+    void assign(const float *xyz, int ni, int nj)
+    {
+        int n = (ni + 1) * (nj + 1);
+        if (ni != this->ni || nj != this->nj || (int)this->x.size() != n)
+        {
+            this->ni = ni;
+            this->nj = nj;
+            this->x.resize(n);
+            this->y.resize(n);
+            this->z.resize(n);
+            this->binomial_i = binomials(ni);
+            this->binomial_j = binomials(nj);
+        }
+        for (int k = 0; k < n; k++)
+        {
+            this->x[k] = xyz[k * 3 + 0];
+            this->y[k] = xyz[k * 3 + 1];
+            this->z[k] = xyz[k * 3 + 2];
+        }
+    }
+
+    static std::vector<float> binomials(int n)
+    {
+        std::vector<float> c(n + 1);
+        double value = 1;
+        for (int k = 0; k <= n; k++)
+        {
+            c[k] = float(value);
+            value = value * (n - k) / (k + 1);
+        }
+        return c;
+    }
+};
+
+// out receives count interleaved xyz points
+typedef void (*BatchEvaluator)(const ControlNetSoA &net, const float *u, const float *v, int count, float *out);
+
+// one sample at a time, same operation order as the vector kernels
+inline void evaluate_points_scalar(const ControlNetSoA &net, const float *u, const float *v, int count, float *out)
+{
+    int ni = net.ni, nj = net.nj;
+    float bu[MAX_BATCH_DEGREE + 1], bv[MAX_BATCH_DEGREE + 1];
+    float pow_a[MAX_BATCH_DEGREE + 1], pow_b[MAX_BATCH_DEGREE + 1];
+
+    for (int s = 0; s < count; s++)
+    {
+        pow_a[0] = pow_b[0] = 1;
+        for (int k = 1; k <= ni; k++)
+        {
+            pow_a[k] = pow_a[k - 1] * u[s];
+            pow_b[k] = pow_b[k - 1] * (1 - u[s]);
+        }
+        for (int k = 0; k <= ni; k++)
+        {
+            bu[k] = net.binomial_i[k] * pow_a[k] * pow_b[ni - k];
+        }
+        for (int k = 1; k <= nj; k++)
+        {
+            pow_a[k] = pow_a[k - 1] * v[s];
+            pow_b[k] = pow_b[k - 1] * (1 - v[s]);
+        }
+        for (int k = 0; k <= nj; k++)
+        {
+            bv[k] = net.binomial_j[k] * pow_a[k] * pow_b[nj - k];
+        }
+
+        float x = 0, y = 0, z = 0;
+        for (int ki = 0; ki <= ni; ki++)
+        {
+            for (int kj = 0; kj <= nj; kj++)
+            {
+                int c = ki * (nj + 1) + kj;
+                float w = bu[ki] * bv[kj];
+                x += net.x[c] * w;
+                y += net.y[c] * w;
+                z += net.z[c] * w;
+            }
+        }
+        out[s * 3 + 0] = x;
+        out[s * 3 + 1] = y;
+        out[s * 3 + 2] = z;
+    }
+}
+
+#ifdef SIMD_EVALUATOR_X86
+
+__attribute__((target("avx2,fma"))) inline void evaluate_points_avx2(const ControlNetSoA &net, const float *u, const float *v, int count, float *out)
+{
+    int ni = net.ni, nj = net.nj;
+    __m256 bu[MAX_BATCH_DEGREE + 1], bv[MAX_BATCH_DEGREE + 1];
+    __m256 pow_a[MAX_BATCH_DEGREE + 1], pow_b[MAX_BATCH_DEGREE + 1];
+    __m256 one = _mm256_set1_ps(1.0f);
+    alignas(32) float lanes[3][8];
+    int s = 0;
+
+    for (; s + 8 <= count; s += 8)
+    {
+        __m256 mu = _mm256_loadu_ps(u + s);
+        __m256 mv = _mm256_loadu_ps(v + s);
+        __m256 one_minus_mu = _mm256_sub_ps(one, mu);
+        __m256 one_minus_mv = _mm256_sub_ps(one, mv);
+
+        pow_a[0] = pow_b[0] = one;
+        for (int k = 1; k <= ni; k++)
+        {
+            pow_a[k] = _mm256_mul_ps(pow_a[k - 1], mu);
+            pow_b[k] = _mm256_mul_ps(pow_b[k - 1], one_minus_mu);
+        }
+        for (int k = 0; k <= ni; k++)
+        {
+            bu[k] = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(net.binomial_i[k]), pow_a[k]), pow_b[ni - k]);
+        }
+        for (int k = 1; k <= nj; k++)
+        {
+            pow_a[k] = _mm256_mul_ps(pow_a[k - 1], mv);
+            pow_b[k] = _mm256_mul_ps(pow_b[k - 1], one_minus_mv);
+        }
+        for (int k = 0; k <= nj; k++)
+        {
+            bv[k] = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(net.binomial_j[k]), pow_a[k]), pow_b[nj - k]);
+        }
+
+        __m256 x = _mm256_setzero_ps(), y = _mm256_setzero_ps(), z = _mm256_setzero_ps();
+        for (int ki = 0; ki <= ni; ki++)
+        {
+            for (int kj = 0; kj <= nj; kj++)
+            {
+                int c = ki * (nj + 1) + kj;
+                __m256 w = _mm256_mul_ps(bu[ki], bv[kj]);
+                x = _mm256_fmadd_ps(_mm256_broadcast_ss(&net.x[c]), w, x);
+                y = _mm256_fmadd_ps(_mm256_broadcast_ss(&net.y[c]), w, y);
+                z = _mm256_fmadd_ps(_mm256_broadcast_ss(&net.z[c]), w, z);
+            }
+        }
+        _mm256_store_ps(lanes[0], x);
+        _mm256_store_ps(lanes[1], y);
+        _mm256_store_ps(lanes[2], z);
+        for (int l = 0; l < 8; l++)
+        {
+            out[(s + l) * 3 + 0] = lanes[0][l];
+            out[(s + l) * 3 + 1] = lanes[1][l];
+            out[(s + l) * 3 + 2] = lanes[2][l];
+        }
+    }
+    evaluate_points_scalar(net, u + s, v + s, count - s, out + s * 3);
+}
+
+inline void evaluate_points_sse(const ControlNetSoA &net, const float *u, const float *v, int count, float *out)
+{
+    int ni = net.ni, nj = net.nj;
+    __m128 bu[MAX_BATCH_DEGREE + 1], bv[MAX_BATCH_DEGREE + 1];
+    __m128 pow_a[MAX_BATCH_DEGREE + 1], pow_b[MAX_BATCH_DEGREE + 1];
+    __m128 one = _mm_set1_ps(1.0f);
+    alignas(16) float lanes[3][4];
+    int s = 0;
+
+    for (; s + 4 <= count; s += 4)
+    {
+        __m128 mu = _mm_loadu_ps(u + s);
+        __m128 mv = _mm_loadu_ps(v + s);
+        __m128 one_minus_mu = _mm_sub_ps(one, mu);
+        __m128 one_minus_mv = _mm_sub_ps(one, mv);
+
+        pow_a[0] = pow_b[0] = one;
+        for (int k = 1; k <= ni; k++)
+        {
+            pow_a[k] = _mm_mul_ps(pow_a[k - 1], mu);
+            pow_b[k] = _mm_mul_ps(pow_b[k - 1], one_minus_mu);
+        }
+        for (int k = 0; k <= ni; k++)
+        {
+            bu[k] = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(net.binomial_i[k]), pow_a[k]), pow_b[ni - k]);
+        }
+        for (int k = 1; k <= nj; k++)
+        {
+            pow_a[k] = _mm_mul_ps(pow_a[k - 1], mv);
+            pow_b[k] = _mm_mul_ps(pow_b[k - 1], one_minus_mv);
+        }
+        for (int k = 0; k <= nj; k++)
+        {
+            bv[k] = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(net.binomial_j[k]), pow_a[k]), pow_b[nj - k]);
+        }
+
+        __m128 x = _mm_setzero_ps(), y = _mm_setzero_ps(), z = _mm_setzero_ps();
+        for (int ki = 0; ki <= ni; ki++)
+        {
+            for (int kj = 0; kj <= nj; kj++)
+            {
+                int c = ki * (nj + 1) + kj;
+                __m128 w = _mm_mul_ps(bu[ki], bv[kj]);
+                x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(net.x[c]), w));
+                y = _mm_add_ps(y, _mm_mul_ps(_mm_set1_ps(net.y[c]), w));
+                z = _mm_add_ps(z, _mm_mul_ps(_mm_set1_ps(net.z[c]), w));
+            }
+        }
+        _mm_store_ps(lanes[0], x);
+        _mm_store_ps(lanes[1], y);
+        _mm_store_ps(lanes[2], z);
+        for (int l = 0; l < 4; l++)
+        {
+            out[(s + l) * 3 + 0] = lanes[0][l];
+            out[(s + l) * 3 + 1] = lanes[1][l];
+            out[(s + l) * 3 + 2] = lanes[2][l];
+        }
+    }
+    evaluate_points_scalar(net, u + s, v + s, count - s, out + s * 3);
+}
+
+#endif
+
+#ifdef SIMD_EVALUATOR_NEON
+
+inline void evaluate_points_neon(const ControlNetSoA &net, const float *u, const float *v, int count, float *out)
+{
+    int ni = net.ni, nj = net.nj;
+    float32x4_t bu[MAX_BATCH_DEGREE + 1], bv[MAX_BATCH_DEGREE + 1];
+    float32x4_t pow_a[MAX_BATCH_DEGREE + 1], pow_b[MAX_BATCH_DEGREE + 1];
+    float32x4_t one = vdupq_n_f32(1.0f);
+    int s = 0;
+
+    for (; s + 4 <= count; s += 4)
+    {
+        float32x4_t mu = vld1q_f32(u + s);
+        float32x4_t mv = vld1q_f32(v + s);
+        float32x4_t one_minus_mu = vsubq_f32(one, mu);
+        float32x4_t one_minus_mv = vsubq_f32(one, mv);
+
+        pow_a[0] = pow_b[0] = one;
+        for (int k = 1; k <= ni; k++)
+        {
+            pow_a[k] = vmulq_f32(pow_a[k - 1], mu);
+            pow_b[k] = vmulq_f32(pow_b[k - 1], one_minus_mu);
+        }
+        for (int k = 0; k <= ni; k++)
+        {
+            bu[k] = vmulq_f32(vmulq_n_f32(pow_a[k], net.binomial_i[k]), pow_b[ni - k]);
+        }
+        for (int k = 1; k <= nj; k++)
+        {
+            pow_a[k] = vmulq_f32(pow_a[k - 1], mv);
+            pow_b[k] = vmulq_f32(pow_b[k - 1], one_minus_mv);
+        }
+        for (int k = 0; k <= nj; k++)
+        {
+            bv[k] = vmulq_f32(vmulq_n_f32(pow_a[k], net.binomial_j[k]), pow_b[nj - k]);
+        }
+
+        float32x4x3_t xyz;
+        xyz.val[0] = xyz.val[1] = xyz.val[2] = vdupq_n_f32(0.0f);
+        for (int ki = 0; ki <= ni; ki++)
+        {
+            for (int kj = 0; kj <= nj; kj++)
+            {
+                int c = ki * (nj + 1) + kj;
+                float32x4_t w = vmulq_f32(bu[ki], bv[kj]);
+                xyz.val[0] = vmlaq_n_f32(xyz.val[0], w, net.x[c]);
+                xyz.val[1] = vmlaq_n_f32(xyz.val[1], w, net.y[c]);
+                xyz.val[2] = vmlaq_n_f32(xyz.val[2], w, net.z[c]);
+            }
+        }
+        // interleaving store, writes the 4 points as xyz xyz xyz xyz
+        vst3q_f32(out + s * 3, xyz);
+    }
+    evaluate_points_scalar(net, u + s, v + s, count - s, out + s * 3);
+}
+
+#endif
+
+struct NamedBatchEvaluator
+{
+    const char *name;
+    BatchEvaluator evaluator;
+};
+
+// every kernel the cpu running this supports, from the scalar one to the widest
+inline std::vector<NamedBatchEvaluator> supported_batch_evaluators()
+{
+    std::vector<NamedBatchEvaluator> evaluators = {{"scalar", evaluate_points_scalar}};
+#ifdef SIMD_EVALUATOR_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        evaluators.push_back({"sse2", evaluate_points_sse});
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        evaluators.push_back({"avx2", evaluate_points_avx2});
+    }
+#elif defined(SIMD_EVALUATOR_NEON)
+    evaluators.push_back({"neon", evaluate_points_neon});
+#endif
+    return evaluators;
+}
+
+// the widest kernel the cpu running this supports
+inline BatchEvaluator select_batch_evaluator(const char **name = nullptr)
+{
+    NamedBatchEvaluator widest = supported_batch_evaluators().back();
+    if (name != nullptr)
+    {
+        *name = widest.name;
+    }
+    return widest.evaluator;
+}
+
+inline void evaluate_points(const ControlNetSoA &net, const float *u, const float *v, int count, float *out)
+{
+    static BatchEvaluator evaluator = select_batch_evaluator();
+    evaluator(net, u, v, count, out);
+}
+
+// largest absolute difference between a kernel, the dispatched one by default, and the
+// scalar reference. the vector kernels fuse multiply-adds so a few ulps of difference are
+// expected
+inline float max_batch_error(const ControlNetSoA &net, const float *u, const float *v, int count, BatchEvaluator evaluator = evaluate_points)
+{
+    std::vector<float> reference(count * 3), batch(count * 3);
+    evaluate_points_scalar(net, u, v, count, reference.data());
+    evaluator(net, u, v, count, batch.data());
+
+    float error = 0;
+    for (int k = 0; k < count * 3; k++)
+    {
+        error = std::max(error, std::fabs(reference[k] - batch[k]));
+    }
+    return error;
+}
+
+#endif
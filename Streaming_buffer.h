@@ -0,0 +1,219 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include "./Gl_extensions.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#define STREAM_SEGMENTS 3
+
+// vertex buffer for data the cpu rewrites while the gpu may still draw from it.
+//
+// with buffer storage (OpenGL 4.4 or ARB_buffer_storage) the buffer holds STREAM_SEGMENTS
+// copies of the data, mapped once, persistently and coherently. a write goes to the next
+// segment after waiting on the fence of the last frame that drew from it, so with three
+// segments the cpu practically never waits and never stalls a draw. every segment remembers
+// the span changed since it was last written, only that span is copied into it. draws
+// select the current segment with base_vertex()
+//
+// without buffer storage there is one segment: a write orphans the buffer with
+// glBufferData(NULL) so the driver can hand out fresh memory instead of waiting for the
+// draws of the old one, and then uploads the whole used range
+class StreamingBuffer
+{
+public:
+    unsigned int buffer;
+    bool persistent;
+    // bytes of one copy of the data
+    size_t segment_size;
+    int current;
+
+    StreamingBuffer() : buffer(0), persistent(false), segment_size(0), current(0), mapped(nullptr), changed(false)
+    {
+        for (int s = 0; s < STREAM_SEGMENTS; s++)
+        {
+            this->fences[s] = 0;
+            this->pending_first[s] = this->pending_last[s] = 0;
+        }
+    }
+
+    void create(size_t segment_size)
+    {
+        this->segment_size = segment_size;
+        this->persistent = glBufferStorage_ != nullptr;
+        glGenBuffers(1, &this->buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+        if (this->persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage_(GL_ARRAY_BUFFER, STREAM_SEGMENTS * segment_size, nullptr, flags);
+            this->mapped = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, STREAM_SEGMENTS * segment_size, flags);
+        }
+        else
+        {
+            glBufferData(GL_ARRAY_BUFFER, segment_size, nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    // reallocates the buffer with segments of segment_size bytes. the gpu copies every old
+    // segment over with one glCopyBufferSubData, nothing goes through the cpu, and a fence
+    // behind the copies keeps writes to the new segments from racing them
+    void grow(size_t segment_size)
+    {
+        unsigned int old_buffer = this->buffer;
+        size_t old_segment_size = this->segment_size;
+        this->release_mapping();
+        this->create(segment_size);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+        int segments = this->persistent ? STREAM_SEGMENTS : 1;
+        for (int s = 0; s < segments; s++)
+        {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, s * old_segment_size, s * segment_size, old_segment_size);
+        }
+        glDeleteBuffers(1, &old_buffer);
+        if (this->persistent)
+        {
+            for (int s = 0; s < STREAM_SEGMENTS; s++)
+            {
+                this->fences[s] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+        }
+    }
+
+    void destroy()
+    {
+        this->release_mapping();
+        glDeleteBuffers(1, &this->buffer);
+    }
+
+    // bytes [first, last) of the data changed, every segment has to pick them up
+    void invalidate(size_t first, size_t last)
+    {
+        this->changed = true;
+        for (int s = 0; s < STREAM_SEGMENTS; s++)
+        {
+            if (this->pending_last[s] <= this->pending_first[s])
+            {
+                this->pending_first[s] = first;
+                this->pending_last[s] = last;
+            }
+            else
+            {
+                this->pending_first[s] = std::min(this->pending_first[s], first);
+                this->pending_last[s] = std::max(this->pending_last[s], last);
+            }
+        }
+    }
+
+    // moves on to the segment that receives the next write and returns in [first, last) the
+    // bytes it is missing out of the used_bytes in use. returns false, and keeps drawing the
+    // current segment, when nothing changed since it was written
+    bool next_segment(size_t used_bytes, size_t &first, size_t &last)
+    {
+        if (!this->changed)
+        {
+            return false;
+        }
+        this->changed = false;
+        int next = this->persistent ? (this->current + 1) % STREAM_SEGMENTS : 0;
+
+        if (this->persistent)
+        {
+            this->wait(next);
+            first = this->pending_first[next];
+            last = std::min(this->pending_last[next], used_bytes);
+        }
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            glBufferData(GL_ARRAY_BUFFER, this->segment_size, nullptr, GL_STREAM_DRAW);
+            first = 0;
+            last = used_bytes;
+        }
+        this->pending_first[next] = this->pending_last[next] = 0;
+        this->current = next;
+        return first < last;
+    }
+
+    // copies size bytes to offset in the current segment
+    void write(size_t offset, size_t size, const void *data)
+    {
+        if (this->persistent)
+        {
+            memcpy(this->mapped + this->current * this->segment_size + offset, data, size);
+        }
+        else
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+        }
+    }
+
+    // first vertex of the current segment for vertices of stride bytes
+    int base_vertex(size_t stride) const
+    {
+        return this->current * this->segment_size / stride;
+    }
+
+    // called after the last draw of a frame, the next write to the segment waits for it
+    void end_frame()
+    {
+        if (!this->persistent)
+        {
+            return;
+        }
+        if (this->fences[this->current] != 0)
+        {
+            glDeleteSync(this->fences[this->current]);
+        }
+        this->fences[this->current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    char *mapped;
+    // invalidate() was called since the current segment was written
+    bool changed;
+    GLsync fences[STREAM_SEGMENTS];
+    size_t pending_first[STREAM_SEGMENTS], pending_last[STREAM_SEGMENTS];
+
+    // drops the fences and unmaps the buffer, pending spans stay as they are
+    void release_mapping()
+    {
+        for (int s = 0; s < STREAM_SEGMENTS; s++)
+        {
+            if (this->fences[s] != 0)
+            {
+                glDeleteSync(this->fences[s]);
+                this->fences[s] = 0;
+            }
+        }
+        if (this->mapped != nullptr)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            this->mapped = nullptr;
+        }
+    }
+
+    void wait(int segment)
+    {
+        GLsync fence = this->fences[segment];
+        if (fence == 0)
+        {
+            return;
+        }
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(fence);
+        this->fences[segment] = 0;
+    }
+};
+
+#endif
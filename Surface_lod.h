@@ -0,0 +1,206 @@
+#ifndef SURFACE_LOD_H
+#define SURFACE_LOD_H
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#define MAX_LOD_LEVELS 6
+#define PRIMITIVE_RESTART_INDEX 0xFFFFFFFF
+
+// one level of detail of the sample grid, a range of the shared index buffer
+struct LodLevel
+{
+    // only every stride-th row and column of the grid is used, plus the last ones
+    int stride;
+    unsigned int first_index;
+    unsigned int num_indices;
+    // largest distance between a skipped sample and the coarse cell it falls in
+    float error;
+    // the rows and columns of the grid the level uses, kept for update_errors() so that a
+    // drag does not allocate them every frame
+    std::vector<int> rows, columns;
+};
+
+// precomputed coarser tessellations of a RES_I x RES_J sample grid. every level indexes the
+// same vertices, so the coarse levels cost no extra vertex storage or upload and a frame that
+// draws one only transforms the vertices it references. select() picks the coarsest level
+// whose geometric error projects to at most a given number of pixels
+class SurfaceLod
+{
+public:
+    std::vector<unsigned int> indices;
+    std::vector<LodLevel> levels;
+    // the errors depend on the shape of the surface and are recomputed when it changed
+    bool errors_stale;
+
+    SurfaceLod() : errors_stale(true), res_i(0), res_j(0) {}
+
+    // indices of all levels for a grid starting at vertex surface_start, either two triangles
+    // per cell or one triangle strip per row separated by the restart index
+    void build(int res_i, int res_j, unsigned int surface_start, bool strips)
+    {
+        this->res_i = res_i;
+        this->res_j = res_j;
+        this->indices.clear();
+        this->levels.clear();
+
+        for (int stride = 1; this->levels.size() < MAX_LOD_LEVELS; stride *= 2)
+        {
+            LodLevel level = {stride, (unsigned int)this->indices.size(), 0, 0.0f, grid_lines(res_i, stride), grid_lines(res_j, stride)};
+            const std::vector<int> &rows = level.rows, &columns = level.columns;
+            for (size_t r = 0; r + 1 < rows.size(); r++)
+            {
+                for (size_t c = 0; c < columns.size(); c++)
+                {
+                    unsigned int a = surface_start + rows[r] * res_j + columns[c];
+                    unsigned int b = surface_start + rows[r + 1] * res_j + columns[c];
+                    if (strips)
+                    {
+                        this->indices.push_back(a);
+                        this->indices.push_back(b);
+                    }
+                    else if (c + 1 < columns.size())
+                    {
+                        unsigned int a_next = surface_start + rows[r] * res_j + columns[c + 1];
+                        unsigned int b_next = surface_start + rows[r + 1] * res_j + columns[c + 1];
+                        this->indices.insert(this->indices.end(), {a, b, b_next, a, b_next, a_next});
+                    }
+                }
+                if (strips)
+                {
+                    this->indices.push_back(PRIMITIVE_RESTART_INDEX);
+                }
+            }
+            level.num_indices = this->indices.size() - level.first_index;
+            // a single cell can not get any coarser
+            bool coarsest = rows.size() == 2 && columns.size() == 2;
+            this->levels.push_back(std::move(level));
+            if (coarsest)
+            {
+                break;
+            }
+        }
+        this->errors_stale = true;
+    }
+
+    // errors and bounding box from the res_i x res_j interleaved xyz samples, mapped to
+    // drawing space by scale and offset per axis
+    void update_errors(const float *samples, const float scale[3], const float offset[3])
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            this->box_min[k] = INFINITY;
+            this->box_max[k] = -INFINITY;
+        }
+        for (int s = 0; s < this->res_i * this->res_j; s++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                float x = samples[s * 3 + k] * scale[k] + offset[k];
+                this->box_min[k] = std::min(this->box_min[k], x);
+                this->box_max[k] = std::max(this->box_max[k], x);
+            }
+        }
+
+        for (LodLevel &level : this->levels)
+        {
+            level.error = 0.0f;
+            if (level.stride == 1)
+            {
+                continue;
+            }
+            const std::vector<int> &rows = level.rows, &columns = level.columns;
+            for (size_t r = 0; r + 1 < rows.size(); r++)
+            {
+                for (size_t c = 0; c + 1 < columns.size(); c++)
+                {
+                    level.error = std::max(level.error, this->cell_error(samples, scale, rows[r], rows[r + 1], columns[c], columns[c + 1]));
+                }
+            }
+        }
+        this->errors_stale = false;
+    }
+
+    // coarsest level whose error stays within max_pixels on a width x height viewport drawn
+    // with the column-major matrix mvp (projection * view * model)
+    const LodLevel &select(const float *mvp, int width, int height, float max_pixels) const
+    {
+        // pixels per unit of length in drawing space at the bounding box corner closest to the
+        // eye, from the rows of mvp that produce clip x and y
+        float min_w = INFINITY;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            float p[3] = {corner & 1 ? this->box_max[0] : this->box_min[0],
+                          corner & 2 ? this->box_max[1] : this->box_min[1],
+                          corner & 4 ? this->box_max[2] : this->box_min[2]};
+            float w = mvp[3] * p[0] + mvp[7] * p[1] + mvp[11] * p[2] + mvp[15];
+            min_w = std::min(min_w, w);
+        }
+        float row_x = std::sqrt(mvp[0] * mvp[0] + mvp[4] * mvp[4] + mvp[8] * mvp[8]);
+        float row_y = std::sqrt(mvp[1] * mvp[1] + mvp[5] * mvp[5] + mvp[9] * mvp[9]);
+        // a box reaching the eye plane shows its detail arbitrarily large, use the full mesh
+        if (min_w <= 1e-6f)
+        {
+            return this->levels[0];
+        }
+        float pixels_per_unit = std::max(0.5f * width * row_x, 0.5f * height * row_y) / min_w;
+
+        for (size_t l = this->levels.size(); l-- > 1;)
+        {
+            if (this->levels[l].error * pixels_per_unit <= max_pixels)
+            {
+                return this->levels[l];
+            }
+        }
+        return this->levels[0];
+    }
+
+private:
+    int res_i, res_j;
+    float box_min[3], box_max[3];
+
+    // every stride-th line of a grid of resolution lines, always ending with the last one
+    static std::vector<int> grid_lines(int resolution, int stride)
+    {
+        std::vector<int> lines;
+        for (int k = 0; k < resolution - 1; k += stride)
+        {
+            lines.push_back(k);
+        }
+        lines.push_back(resolution - 1);
+        return lines;
+    }
+
+    // largest distance between the samples inside a coarse cell and the bilinear
+    // interpolation of its corner samples
+    float cell_error(const float *samples, const float scale[3], int i0, int i1, int j0, int j1) const
+    {
+        const float *a = &samples[(i0 * this->res_j + j0) * 3];
+        const float *b = &samples[(i1 * this->res_j + j0) * 3];
+        const float *c = &samples[(i0 * this->res_j + j1) * 3];
+        const float *d = &samples[(i1 * this->res_j + j1) * 3];
+        float error = 0.0f;
+        for (int i = i0; i <= i1; i++)
+        {
+            float s = float(i - i0) / (i1 - i0);
+            for (int j = j0; j <= j1; j++)
+            {
+                float t = float(j - j0) / (j1 - j0);
+                const float *p = &samples[(i * this->res_j + j) * 3];
+                float distance = 0.0f;
+                for (int k = 0; k < 3; k++)
+                {
+                    float bilinear = (1 - s) * (1 - t) * a[k] + s * (1 - t) * b[k] + (1 - s) * t * c[k] + s * t * d[k];
+                    float delta = (p[k] - bilinear) * scale[k];
+                    distance += delta * delta;
+                }
+                error = std::max(error, distance);
+            }
+        }
+        return std::sqrt(error);
+    }
+};
+
+#endif
@@ -0,0 +1,396 @@
+#include "./Surface_patch.h"
+#include "./Bezier_evaluator.h"
+#include "./De_casteljau.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+void SurfacePatch::resize(int ni, int nj, int res_i, int res_j)
+{
+    res_i = std::max(res_i, 1);
+    res_j = std::max(res_j, 1);
+    if (ni != this->ni || nj != this->nj)
+    {
+        this->cp.resize((ni + 1) * (nj + 1) * 3);
+        this->point_weights.resize(2 * (ni + 1) + 2 * (nj + 1));
+    }
+    if (ni != this->ni || nj != this->nj || res_j != this->res_j)
+    {
+        this->partial.resize((ni + 1) * res_j * 3);
+        this->partial_dv.resize((ni + 1) * res_j * 3);
+    }
+    if (res_j != this->res_j)
+    {
+        this->delta_row.resize(res_j * 3);
+        this->delta_row_dv.resize(res_j * 3);
+    }
+    if (res_i != this->res_i || res_j != this->res_j)
+    {
+        this->outp.resize(res_i * res_j * 3);
+        this->outp_du.resize(res_i * res_j * 3);
+        this->outp_dv.resize(res_i * res_j * 3);
+        this->sample_u.clear();
+        this->sample_v.clear();
+    }
+    this->ni = ni;
+    this->nj = nj;
+    this->res_i = res_i;
+    this->res_j = res_j;
+}
+
+void SurfacePatch::set_num_threads(int num_threads)
+{
+    num_threads = std::max(num_threads, 1);
+    if (num_threads != this->num_threads)
+    {
+        this->pool.reset(num_threads > 1 ? new ThreadPool(num_threads) : nullptr);
+        this->num_threads = num_threads;
+    }
+}
+
+void SurfacePatch::evaluate()
+{
+    this->update_basis();
+
+    bool tables = this->mode == EVAL_BASIS_TABLES;
+    // the de casteljau hull yields the derivatives along with the positions
+    bool derivatives_done = false;
+    if (this->mode == EVAL_SIMD_BATCH && this->ni <= MAX_BATCH_DEGREE && this->nj <= MAX_BATCH_DEGREE)
+    {
+        this->evaluate_batch();
+    }
+    else if (this->mode == EVAL_FORWARD_DIFFERENCES)
+    {
+        this->evaluate_forward_differences();
+    }
+    else if (this->mode == EVAL_DE_CASTELJAU)
+    {
+        if (this->de_casteljau_double)
+            this->evaluate_de_casteljau<double>();
+        else
+            this->evaluate_de_casteljau<float>();
+        derivatives_done = true;
+    }
+    else
+    {
+        tables = true;
+    }
+
+    // the table path computes the derivatives in the same pass, the others get them separately
+    if (tables || (this->compute_derivatives && !derivatives_done))
+    {
+        this->evaluate_basis_tables(tables, this->compute_derivatives);
+    }
+}
+
+void SurfacePatch::evaluate_basis_tables(bool positions, bool derivatives)
+{
+    int ni = this->ni, nj = this->nj, res_i = this->res_i, res_j = this->res_j;
+    const float *basis_i = this->basis_i.weights.data();
+    const float *basis_j = this->basis_j.weights.data();
+    const float *dbasis_i = this->basis_i.derivatives.data();
+    const float *dbasis_j = this->basis_j.derivatives.data();
+    GridKernels kernels = grid_kernels(ni, nj, this->use_specialized);
+
+    auto columns = [&](int j0, int j1) {
+        kernels.contract_j(this->cp.data, basis_j, ni, nj, res_j, j0, j1, this->partial.data);
+        if (derivatives)
+        {
+            kernels.contract_j(this->cp.data, dbasis_j, ni, nj, res_j, j0, j1, this->partial_dv.data);
+        }
+    };
+    auto tile = [&](int i0, int i1, int j0, int j1) {
+        if (positions)
+        {
+            kernels.contract_i(basis_i, ni, res_j, this->partial.data, i0, i1, j0, j1, this->outp.data);
+        }
+        if (derivatives)
+        {
+            kernels.contract_i(dbasis_i, ni, res_j, this->partial.data, i0, i1, j0, j1, this->outp_du.data);
+            kernels.contract_i(basis_i, ni, res_j, this->partial_dv.data, i0, i1, j0, j1, this->outp_dv.data);
+        }
+    };
+
+    if (this->pool == nullptr)
+    {
+        columns(0, res_j);
+        tile(0, res_i, 0, res_j);
+        return;
+    }
+
+    // the partial products are split by columns, then every tile of the grid only reads
+    // the columns of partial it covers
+    int tiles_i = (res_i + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_j = (res_j + TILE_SIZE - 1) / TILE_SIZE;
+    this->pool->parallel_for(tiles_j, [&](int tj) {
+        int j0 = tj * TILE_SIZE;
+        columns(j0, std::min(j0 + TILE_SIZE, res_j));
+    });
+    this->pool->parallel_for(tiles_i * tiles_j, [&](int t) {
+        int i0 = t / tiles_j * TILE_SIZE, j0 = t % tiles_j * TILE_SIZE;
+        tile(i0, std::min(i0 + TILE_SIZE, res_i), j0, std::min(j0 + TILE_SIZE, res_j));
+    });
+}
+
+void SurfacePatch::evaluate_forward_differences()
+{
+    int ni = this->ni, nj = this->nj, res_i = this->res_i, res_j = this->res_j;
+    int row_size = res_j * 3;
+    int interval = std::max(this->reanchor_interval, 1);
+    GridKernels kernels = grid_kernels(ni, nj, this->use_specialized);
+
+    kernels.contract_j(this->cp.data, this->basis_j.weights.data(), ni, nj, res_j, 0, res_j, this->partial.data);
+    this->fd_table.resize((ni + 1) * row_size);
+    this->fd_weights.resize(ni + 1);
+    double *d = this->fd_table.data();
+    double *w = this->fd_weights.data();
+
+    for (int anchor = 0; anchor < res_i; anchor += interval)
+    {
+        // rows anchor..anchor + ni, the last ones may lie past u = 1 which is fine for a polynomial
+        for (int m = 0; m <= ni; m++)
+        {
+            bernstein_row(ni, grid_parameter(anchor + m, res_i), w);
+            double *dm = d + m * row_size;
+            std::fill(dm, dm + row_size, 0.0);
+            for (int ki = 0; ki <= ni; ki++)
+            {
+                const float *partial_row = &this->partial[ki * row_size];
+                for (int j = 0; j < row_size; j++)
+                {
+                    dm[j] += w[ki] * partial_row[j];
+                }
+            }
+        }
+
+        // d[k] = k-th forward difference at the anchor row
+        for (int k = 1; k <= ni; k++)
+        {
+            for (int m = ni; m >= k; m--)
+            {
+                double *dm = d + m * row_size;
+                const double *dm_1 = d + (m - 1) * row_size;
+                for (int j = 0; j < row_size; j++)
+                {
+                    dm[j] -= dm_1[j];
+                }
+            }
+        }
+
+        int block_end = std::min(anchor + interval, res_i);
+        for (int i = anchor; i < block_end; i++)
+        {
+            if (i > anchor)
+            {
+                for (int k = 0; k < ni; k++)
+                {
+                    double *dk = d + k * row_size;
+                    const double *dk_1 = d + (k + 1) * row_size;
+                    for (int j = 0; j < row_size; j++)
+                    {
+                        dk[j] += dk_1[j];
+                    }
+                }
+            }
+            float *out_row = this->sample(i, 0);
+            for (int j = 0; j < row_size; j++)
+            {
+                out_row[j] = float(d[j]);
+            }
+        }
+    }
+}
+
+template <typename Real>
+void SurfacePatch::evaluate_de_casteljau()
+{
+    int ni = this->ni, nj = this->nj, res_i = this->res_i, res_j = this->res_j;
+    bool derivatives = this->compute_derivatives;
+    std::vector<Real> scratch((std::max(ni, nj) + 1) * 3);
+    // every row of the net reduced at each muj, and its derivative along v
+    std::vector<Real> rows((ni + 1) * res_j * 3), rows_dv(derivatives ? (ni + 1) * res_j * 3 : 0);
+
+    for (int ki = 0; ki <= ni; ki++)
+    {
+        const float *cp_row = this->control_point(ki, 0);
+        for (int j = 0; j < res_j; j++)
+        {
+            int k = (ki * res_j + j) * 3;
+            std::copy(cp_row, cp_row + (nj + 1) * 3, scratch.begin());
+            if (derivatives)
+                de_casteljau(scratch.data(), nj, Real(grid_parameter(j, res_j)), &rows[k], &rows_dv[k]);
+            else
+                de_casteljau(scratch.data(), nj, Real(grid_parameter(j, res_j)), &rows[k]);
+        }
+    }
+
+    // dS/du is the tangent of the column reduction, dS/dv the same reduction of the row
+    // derivatives
+    for (int i = 0; i < res_i; i++)
+    {
+        Real u = Real(grid_parameter(i, res_i));
+        for (int j = 0; j < res_j; j++)
+        {
+            for (int ki = 0; ki <= ni; ki++)
+            {
+                std::copy(&rows[(ki * res_j + j) * 3], &rows[(ki * res_j + j) * 3] + 3, &scratch[ki * 3]);
+            }
+            Real p[3], pu[3] = {0, 0, 0}, pv[3] = {0, 0, 0};
+            if (derivatives)
+                de_casteljau(scratch.data(), ni, u, p, pu);
+            else
+                de_casteljau(scratch.data(), ni, u, p);
+            float *out = this->sample(i, j);
+            out[0] = float(p[0]);
+            out[1] = float(p[1]);
+            out[2] = float(p[2]);
+            if (!derivatives)
+            {
+                continue;
+            }
+
+            for (int ki = 0; ki <= ni; ki++)
+            {
+                std::copy(&rows_dv[(ki * res_j + j) * 3], &rows_dv[(ki * res_j + j) * 3] + 3, &scratch[ki * 3]);
+            }
+            de_casteljau(scratch.data(), ni, u, pv);
+            float *out_du = this->sample_du(i, j), *out_dv = this->sample_dv(i, j);
+            for (int c = 0; c < 3; c++)
+            {
+                out_du[c] = float(pu[c]);
+                out_dv[c] = float(pv[c]);
+            }
+        }
+    }
+}
+
+void SurfacePatch::evaluate_batch()
+{
+    if (this->sample_u.empty())
+    {
+        for (int i = 0; i < this->res_i; i++)
+        {
+            for (int j = 0; j < this->res_j; j++)
+            {
+                this->sample_u.push_back(float(grid_parameter(i, this->res_i)));
+                this->sample_v.push_back(float(grid_parameter(j, this->res_j)));
+            }
+        }
+    }
+    this->net_soa.assign(this->cp.data, this->ni, this->nj);
+    evaluate_points(this->net_soa, this->sample_u.data(), this->sample_v.data(), this->num_samples(), this->outp.data);
+}
+
+void SurfacePatch::evaluate_point(double u, double v, float *position, float *du, float *dv)
+{
+    int ni = this->ni, nj = this->nj;
+    double *bu = this->point_weights.data(), *dbu = bu + ni + 1;
+    double *bv = dbu + ni + 1, *dbv = bv + nj + 1;
+    bernstein_row(ni, u, bu);
+    bernstein_row(nj, v, bv);
+    bernstein_derivative_row(ni, u, dbu);
+    bernstein_derivative_row(nj, v, dbv);
+
+    double p[3] = {0, 0, 0}, pu[3] = {0, 0, 0}, pv[3] = {0, 0, 0};
+    for (int ki = 0; ki <= ni; ki++)
+    {
+        for (int kj = 0; kj <= nj; kj++)
+        {
+            const float *cp = this->control_point(ki, kj);
+            for (int c = 0; c < 3; c++)
+            {
+                p[c] += cp[c] * bu[ki] * bv[kj];
+                pu[c] += cp[c] * dbu[ki] * bv[kj];
+                pv[c] += cp[c] * bu[ki] * dbv[kj];
+            }
+        }
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        position[c] = float(p[c]);
+        if (du != nullptr)
+            du[c] = float(pu[c]);
+        if (dv != nullptr)
+            dv[c] = float(pv[c]);
+    }
+}
+
+// y[k] += a * x[k], kept free of branches so that it vectorizes
+static inline void axpy(float a, const float *__restrict x, float *__restrict y, int count)
+{
+    for (int k = 0; k < count; k++)
+    {
+        y[k] += a * x[k];
+    }
+}
+
+bool SurfacePatch::apply_delta(int ci, int cj, const float delta[3], int &i_min, int &i_max, int &j_min, int &j_max)
+{
+    bool derivatives = this->compute_derivatives;
+    float *cp = this->control_point(ci, cj);
+    cp[0] += delta[0];
+    cp[1] += delta[1];
+    cp[2] += delta[2];
+
+    // the column factor is the same for every row, so it is computed once and every row
+    // below is a contiguous axpy over the columns it reaches
+    float *row = this->delta_row.data, *row_dv = this->delta_row_dv.data;
+    j_min = this->res_j;
+    j_max = -1;
+    for (int j = 0; j < this->res_j; j++)
+    {
+        float wj = this->basis_j.at(j, cj);
+        float dwj = derivatives ? this->basis_j.derivative_at(j, cj) : 0.0f;
+        if (wj != 0.0f || dwj != 0.0f)
+        {
+            j_min = std::min(j_min, j);
+            j_max = j;
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            row[j * 3 + c] = delta[c] * wj;
+            row_dv[j * 3 + c] = delta[c] * dwj;
+        }
+    }
+
+    i_min = this->res_i;
+    i_max = -1;
+    if (j_max < 0)
+    {
+        return false;
+    }
+    int first = j_min * 3, count = (j_max - j_min + 1) * 3;
+    for (int i = 0; i < this->res_i; i++)
+    {
+        float wi = this->basis_i.at(i, ci);
+        float dwi = derivatives ? this->basis_i.derivative_at(i, ci) : 0.0f;
+        if (wi == 0.0f && dwi == 0.0f)
+        {
+            continue;
+        }
+        i_min = std::min(i_min, i);
+        i_max = i;
+        axpy(wi, row + first, this->sample(i, 0) + first, count);
+        if (derivatives)
+        {
+            axpy(dwi, row + first, this->sample_du(i, 0) + first, count);
+            axpy(wi, row_dv + first, this->sample_dv(i, 0) + first, count);
+        }
+    }
+    return i_max >= 0;
+}
+
+void random_control_net(SurfacePatch &patch, unsigned int seed)
+{
+    srand(seed);
+    for (int i = 0; i <= patch.ni; i++)
+    {
+        for (int j = 0; j <= patch.nj; j++)
+        {
+            float *cp = patch.control_point(i, j);
+            cp[0] = i;
+            cp[1] = j;
+            cp[2] = (rand() % 10000) / 10000.0;
+        }
+    }
+}
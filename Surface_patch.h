@@ -0,0 +1,206 @@
+#ifndef SURFACE_PATCH_H
+#define SURFACE_PATCH_H
+
+#include "./Bernstein_basis.h"
+#include "./Simd_evaluator.h"
+#include "./Thread_pool.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#define CACHE_LINE_SIZE 64
+// samples per side of the tiles the grid is split into for multithreaded evaluation, a
+// 64 x 64 tile of xyz floats is 48KB and its slice of the partial products stays in L2
+#define TILE_SIZE 64
+
+// how SurfacePatch::evaluate() computes the samples
+enum EvaluationMode
+{
+    // two dense products with the basis tables, specialized per degree when possible
+    EVAL_BASIS_TABLES,
+    // every sample evaluated independently by the simd batch kernels of Simd_evaluator.h
+    EVAL_SIMD_BATCH,
+    // rows produced with additions only from a forward difference table, re-anchored periodically
+    EVAL_FORWARD_DIFFERENCES,
+    // de casteljau reduction of every row then every column, stable for high degrees
+    EVAL_DE_CASTELJAU,
+};
+
+// rows stepped by forward differences before they are evaluated exactly again, the
+// rounding error of the difference table grows with the number of steps
+#define DEFAULT_REANCHOR_INTERVAL 16
+
+// flat float array aligned to a cache line, memory is only touched when it grows
+class AlignedBuffer
+{
+public:
+    float *data;
+    int size;
+    int capacity;
+
+    AlignedBuffer() : data(nullptr), size(0), capacity(0) {}
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    ~AlignedBuffer()
+    {
+        std::free(this->data);
+    }
+
+    // contents are zeroed whenever the size changes
+    void resize(int size)
+    {
+        if (size > this->capacity)
+        {
+            std::free(this->data);
+            size_t bytes = (size * sizeof(float) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+            this->data = (float *)std::aligned_alloc(CACHE_LINE_SIZE, bytes);
+            this->capacity = bytes / sizeof(float);
+        }
+        this->size = size;
+        std::memset(this->data, 0, size * sizeof(float));
+    }
+
+    float &operator[](int i) { return this->data[i]; }
+    const float &operator[](int i) const { return this->data[i]; }
+};
+
+// a bezier patch of degree (ni, nj) sampled on a (res_i x res_j) uniform grid. the control
+// net and the samples live in flat xyz buffers sized at runtime, so the degree and the
+// resolution can change without recompiling
+class SurfacePatch
+{
+public:
+    int ni, nj;
+    int res_i, res_j;
+    BasisTable basis_i, basis_j;
+    EvaluationMode mode;
+    // use the compile-time evaluators of Bezier_evaluator.h when the degree has one
+    bool use_specialized;
+    int num_threads;
+    int reanchor_interval;
+    // accumulate the de casteljau evaluation in double instead of float
+    bool de_casteljau_double;
+    // also compute the partial derivatives dS/du and dS/dv of every sample
+    bool compute_derivatives;
+
+    SurfacePatch(int ni, int nj, int res_i, int res_j) : ni(-1), nj(-1), res_i(0), res_j(0), mode(EVAL_BASIS_TABLES), use_specialized(true), num_threads(1), reanchor_interval(DEFAULT_REANCHOR_INTERVAL), de_casteljau_double(false), compute_derivatives(true)
+    {
+        this->resize(ni, nj, res_i, res_j);
+    }
+
+    // reallocates only what changed, the control net and the samples are reset to 0. a
+    // resolution of 1 samples only the edge u = 0 or v = 0, smaller ones are raised to 1
+    void resize(int ni, int nj, int res_i, int res_j);
+
+    // the basis table evaluation splits the grid into tiles evaluated by this many threads,
+    // each sample is computed by exactly one thread so the output does not depend on it
+    void set_num_threads(int num_threads);
+
+    int num_control_points() const
+    {
+        return (this->ni + 1) * (this->nj + 1);
+    }
+
+    int num_samples() const
+    {
+        return this->res_i * this->res_j;
+    }
+
+    float *control_point(int i, int j)
+    {
+        return &this->cp[(i * (this->nj + 1) + j) * 3];
+    }
+
+    float *sample(int i, int j)
+    {
+        return &this->outp[(i * this->res_j + j) * 3];
+    }
+
+    // partial derivatives at sample (i, j) with respect to mui and muj, valid after evaluate()
+    // when compute_derivatives is set
+    float *sample_du(int i, int j)
+    {
+        return &this->outp_du[(i * this->res_j + j) * 3];
+    }
+
+    float *sample_dv(int i, int j)
+    {
+        return &this->outp_dv[(i * this->res_j + j) * 3];
+    }
+
+    const float *control_net() const
+    {
+        return this->cp.data;
+    }
+
+    const float *samples() const
+    {
+        return this->outp.data;
+    }
+
+    // returns true if the basis tables had to be rebuilt, i.e. the degree or resolution changed
+    bool update_basis()
+    {
+        bool changed_i = this->basis_i.update(this->ni, this->res_i);
+        bool changed_j = this->basis_j.update(this->nj, this->res_j);
+        return changed_i || changed_j;
+    }
+
+    void evaluate();
+
+    // evaluates every sample as two dense products with the basis tables. the derivatives
+    // reuse the same partial products: dS/du = sum_ki B'_ki(mui) * partial[ki][j], and
+    // dS/dv = sum_ki B_ki(mui) * partial_dv[ki][j] with partial_dv built from B'_kj(muj)
+    void evaluate_basis_tables(bool positions = true, bool derivatives = false);
+
+    // along i every column of the grid is a polynomial of degree ni sampled at uniform steps,
+    // so once the ni + 1 forward differences of a row are known each following row costs ni
+    // additions per float: d[k] += d[k + 1]. the table is kept in double and rebuilt every
+    // reanchor_interval rows from ni + 1 rows evaluated directly, since its rounding error
+    // is amplified by roughly 2^ni and grows with steps^ni
+    void evaluate_forward_differences();
+
+    // reduces every row of the control net at each muj, then every resulting column at each mui,
+    // O(res_j * ni * nj^2 + res_i * res_j * ni^2) but without any powers or binomials. the
+    // derivatives come from the last two points of the same hulls, in the same precision
+    template <typename Real>
+    void evaluate_de_casteljau();
+
+    // evaluates the whole grid as one batch of independent (u, v) samples
+    void evaluate_batch();
+
+    // position and partial derivatives at an arbitrary (u, v), accumulated in double.
+    // du and dv may be nullptr. the weights go to scratch space of the patch, so it does not
+    // allocate but must not be called from several threads at once
+    void evaluate_point(double u, double v, float *position, float *du = nullptr, float *dv = nullptr);
+
+    // moves CP[ci][cj] by delta and applies the matching rank-1 update
+    // outp[i][j] += delta * B_ci(mui) * B_cj(muj) to the samples, and the same with B' to the
+    // derivatives. the range of samples that changed is returned through i_min..i_max and
+    // j_min..j_max, false if none did. every update rounds again, evaluate() once the drag is
+    // over to get rid of the accumulated error
+    bool apply_delta(int ci, int cj, const float delta[3], int &i_min, int &i_max, int &j_min, int &j_max);
+
+private:
+    AlignedBuffer cp;
+    AlignedBuffer outp;
+    AlignedBuffer partial;
+    AlignedBuffer outp_du, outp_dv, partial_dv;
+    // delta * B_cj(muj) and delta * B'_cj(muj) of apply_delta(), laid out like a row of samples
+    AlignedBuffer delta_row, delta_row_dv;
+    std::vector<double> fd_table, fd_weights;
+    // B and B' along u, then along v, of evaluate_point()
+    std::vector<double> point_weights;
+    ControlNetSoA net_soa;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<float> sample_u, sample_v;
+};
+
+// control net with CP[i][j] = (i, j, random height in [0, 1)), the kind of net the viewer
+// starts with. the same seed always gives the same net
+void random_control_net(SurfacePatch &patch, unsigned int seed);
+
+#endif
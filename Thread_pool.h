@@ -0,0 +1,130 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads that run the tasks of one parallel_for() at a time. the
+// calling thread works on the tasks too, so a pool of n threads starts n - 1 workers
+class ThreadPool
+{
+public:
+    ThreadPool(int num_threads) : generation(0), stopping(false), num_tasks(0), tasks_done(0)
+    {
+        for (int t = 1; t < num_threads; t++)
+        {
+            this->workers.emplace_back(&ThreadPool::worker_loop, this);
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->work_ready.notify_all();
+        for (std::thread &worker : this->workers)
+        {
+            worker.join();
+        }
+    }
+
+    int size() const
+    {
+        return this->workers.size() + 1;
+    }
+
+    // runs task(k) for every k in [0, count) and returns once all of them finished. tasks are
+    // handed out in any order, so each one must write to its own part of the output
+    void parallel_for(int count, const std::function<void(int)> &task)
+    {
+        if (this->workers.empty() || count <= 1)
+        {
+            for (int k = 0; k < count; k++)
+            {
+                task(k);
+            }
+            return;
+        }
+
+        {
+            // workers that woke up late for the previous call must be out before the counters are reset
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->work_done.wait(lock, [this] { return this->active_workers == 0; });
+            this->task = &task;
+            this->num_tasks = count;
+            this->next_task = 0;
+            this->tasks_done = 0;
+            this->generation++;
+        }
+        this->work_ready.notify_all();
+
+        this->run_tasks(&task, count);
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->work_done.wait(lock, [this] { return this->tasks_done == this->num_tasks && this->active_workers == 0; });
+        this->task = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_ready, work_done;
+    unsigned long generation;
+    bool stopping;
+    const std::function<void(int)> *task = nullptr;
+    int num_tasks;
+    std::atomic<int> next_task{0};
+    int tasks_done;
+    int active_workers = 0;
+
+    void run_tasks(const std::function<void(int)> *task, int count)
+    {
+        int done = 0;
+        for (int k = this->next_task++; k < count; k = this->next_task++)
+        {
+            (*task)(k);
+            done++;
+        }
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->tasks_done += done;
+    }
+
+    void worker_loop()
+    {
+        unsigned long seen = 0;
+        while (true)
+        {
+            const std::function<void(int)> *task;
+            int count;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->work_ready.wait(lock, [&] { return this->stopping || this->generation != seen; });
+                if (this->stopping)
+                {
+                    return;
+                }
+                seen = this->generation;
+                task = this->task;
+                count = this->task != nullptr ? this->num_tasks : 0;
+                this->active_workers++;
+            }
+            this->run_tasks(task, count);
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->active_workers--;
+            }
+            this->work_done.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include "./glad.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// layouts the vertex buffer can hold. both start with the float3 position, so the
+// tessellation path that only reads positions works with either
+//
+// VERTEX_FLOAT    float3 position, float3 normal, float2 tex_coord             32 bytes
+// VERTEX_COMPACT  float3 position, 10:10:10:2 snorm normal, half2 tex_coord    20 bytes
+//
+// the packed normal keeps about 3 significant digits per component, plenty for shading. halves
+// hold every integer up to 2048 exactly, which covers the 2i - 1 coordinates of a grid of up to
+// 1024 samples per side, fractional coordinates lose precision as they grow
+enum VertexFormat
+{
+    VERTEX_FLOAT,
+    VERTEX_COMPACT
+};
+
+#define FLOAT_VERTEX_SIZE (8 * sizeof(float))
+#define COMPACT_VERTEX_SIZE 20
+
+inline size_t vertex_size(VertexFormat format)
+{
+    return format == VERTEX_COMPACT ? COMPACT_VERTEX_SIZE : FLOAT_VERTEX_SIZE;
+}
+
+// normal with components in [-1, 1] as GL_INT_2_10_10_10_REV: x in the lowest 10 bits,
+// then y and z, w is left 0
+inline uint32_t pack_normal(const float *normal)
+{
+    uint32_t packed = 0;
+    for (int k = 0; k < 3; k++)
+    {
+        float c = normal[k] < -1.0f ? -1.0f : (normal[k] > 1.0f ? 1.0f : normal[k]);
+        int32_t value = (int32_t)std::lround(c * 511.0f);
+        packed |= (uint32_t(value) & 0x3FF) << (10 * k);
+    }
+    return packed;
+}
+
+// ieee 754 half with round to nearest, overflow becomes infinity and tiny values denormals
+inline uint16_t float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = int32_t((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF)
+    {
+        // infinity stays infinity, nan keeps a mantissa bit
+        return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+    }
+    if (exponent >= 31)
+    {
+        return sign | 0x7C00;
+    }
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint16_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+        {
+            half++;
+        }
+        return sign | half;
+    }
+    uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+    // a carry out of the mantissa correctly moves on to the next exponent
+    if (mantissa & 0x1000)
+    {
+        half++;
+    }
+    return half;
+}
+
+// writes the vertex made of position, normal and tex_coord (8 floats) to dst in format
+inline void encode_vertex(VertexFormat format, const float *properties, unsigned char *dst)
+{
+    if (format == VERTEX_FLOAT)
+    {
+        memcpy(dst, properties, FLOAT_VERTEX_SIZE);
+        return;
+    }
+    uint32_t normal = pack_normal(properties + 3);
+    uint16_t tex_coord[2] = {float_to_half(properties[6]), float_to_half(properties[7])};
+    memcpy(dst, properties, 3 * sizeof(float));
+    memcpy(dst + 12, &normal, sizeof(normal));
+    memcpy(dst + 16, tex_coord, sizeof(tex_coord));
+}
+
+// attribute 0 position, 1 normal and 2 tex_coord from the bound array buffer
+inline void setup_vertex_attributes(VertexFormat format)
+{
+    GLsizei stride = vertex_size(format);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+    glEnableVertexAttribArray(0);
+    if (format == VERTEX_COMPACT)
+    {
+        // packed types always carry 4 components, the shader only reads xyz
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)12);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)16);
+    }
+    else
+    {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+    }
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+}
+
+#endif
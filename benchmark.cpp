@@ -0,0 +1,148 @@
+// command to compile on my environment (linux mint):
+// make benchmark.exec
+
+// execute:
+// ./benchmark.exec
+
+// compares the cost and the error of the surface evaluators against a long double
+// de casteljau reference, on the same kind of control nets the viewer starts with. every
+// batch kernel the cpu supports is also checked against that reference and against the
+// scalar kernel, the exit status is non-zero when one of them is off by more than
+// BATCH_TOLERANCE
+
+#include "./Surface_patch.h"
+#include "./De_casteljau.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+#define BENCH_RES 100
+#define BENCH_REPEATS 5
+// relative to the extent of the control net
+#define BATCH_TOLERANCE 1e-5
+
+// milliseconds per evaluation of the whole grid
+double time_evaluation(SurfacePatch &patch)
+{
+    patch.evaluate();
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < BENCH_REPEATS; r++)
+    {
+        patch.evaluate();
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(end - start).count() / BENCH_REPEATS;
+}
+
+// largest distance between the samples of the patch and the reference grid
+double max_error(const float *samples, int count, const vector<long double> &reference)
+{
+    double error = 0;
+    for (int k = 0; k < count * 3; k++)
+    {
+        error = max(error, (double)fabsl(samples[k] - reference[k]));
+    }
+    return error;
+}
+
+// times every batch kernel on the samples of the grid, returns false if one strays from the
+// reference or from the scalar kernel by more than BATCH_TOLERANCE
+bool benchmark_batch_kernels(SurfacePatch &patch, const vector<long double> &reference)
+{
+    int n = patch.ni;
+    ControlNetSoA net;
+    net.assign(patch.control_net(), patch.ni, patch.nj);
+    vector<float> u(patch.num_samples()), v(patch.num_samples()), out(patch.num_samples() * 3);
+    for (int i = 0; i < BENCH_RES; i++)
+    {
+        for (int j = 0; j < BENCH_RES; j++)
+        {
+            u[i * BENCH_RES + j] = float(i) / (BENCH_RES - 1);
+            v[i * BENCH_RES + j] = float(j) / (BENCH_RES - 1);
+        }
+    }
+    // the viewer's nets span [0, ni] x [0, nj]
+    double tolerance = BATCH_TOLERANCE * n;
+
+    bool accurate = true;
+    for (const NamedBatchEvaluator &kernel : supported_batch_evaluators())
+    {
+        kernel.evaluator(net, u.data(), v.data(), patch.num_samples(), out.data());
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < BENCH_REPEATS; r++)
+        {
+            kernel.evaluator(net, u.data(), v.data(), patch.num_samples(), out.data());
+        }
+        auto end = chrono::steady_clock::now();
+        double ms = chrono::duration<double, milli>(end - start).count() / BENCH_REPEATS;
+
+        double error = max_error(out.data(), patch.num_samples(), reference);
+        double scalar_error = max_batch_error(net, u.data(), v.data(), patch.num_samples(), kernel.evaluator);
+        printf("degree %2d  batch %-14s %9.3f ms  max error %.3e  vs scalar %.3e\n", n, kernel.name, ms, error, scalar_error);
+        if (error > tolerance || scalar_error > tolerance)
+        {
+            printf("the %s batch kernel exceeds the tolerance of %.3e\n", kernel.name, tolerance);
+            accurate = false;
+        }
+    }
+    return accurate;
+}
+
+bool benchmark_degree(int n)
+{
+    SurfacePatch patch(n, n, BENCH_RES, BENCH_RES);
+    random_control_net(patch, 1);
+
+    vector<long double> reference(patch.num_samples() * 3);
+    vector<long double> row((n + 1) * 3), column((n + 1) * 3);
+    for (int i = 0; i < BENCH_RES; i++)
+    {
+        for (int j = 0; j < BENCH_RES; j++)
+        {
+            for (int ki = 0; ki <= n; ki++)
+            {
+                for (int k = 0; k < (n + 1) * 3; k++)
+                {
+                    row[k] = patch.control_point(ki, 0)[k];
+                }
+                de_casteljau(row.data(), n, (long double)j / (BENCH_RES - 1), &column[ki * 3]);
+            }
+            de_casteljau(column.data(), n, (long double)i / (BENCH_RES - 1), &reference[(i * BENCH_RES + j) * 3]);
+        }
+    }
+
+    struct
+    {
+        const char *name;
+        EvaluationMode mode;
+        bool use_double;
+    } evaluators[] = {
+        {"blend() tables", EVAL_BASIS_TABLES, false},
+        {"de casteljau float", EVAL_DE_CASTELJAU, false},
+        {"de casteljau double", EVAL_DE_CASTELJAU, true},
+    };
+
+    for (auto &evaluator : evaluators)
+    {
+        patch.mode = evaluator.mode;
+        patch.de_casteljau_double = evaluator.use_double;
+        double ms = time_evaluation(patch);
+        printf("degree %2d  %-20s %9.3f ms  max error %.3e\n", n, evaluator.name, ms, max_error(patch.samples(), patch.num_samples(), reference));
+    }
+    return n > MAX_BATCH_DEGREE || benchmark_batch_kernels(patch, reference);
+}
+
+int main()
+{
+    int degrees[] = {3, 5, 8, 15, 20, 30, 40};
+    bool accurate = true;
+    for (int n : degrees)
+    {
+        accurate = benchmark_degree(n) && accurate;
+    }
+    return accurate ? 0 : 1;
+}
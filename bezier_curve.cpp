@@ -1,22 +1,24 @@
-// command to compile on my environment (linux mint):
-// g++ -c bezier_curve.cpp
-
-// command to link:
-// g++ bezier_curve.o -o bezier_curve.exec -lGL -lGLU -lglfw3 -lX11 -lXxf86vm -lXrandr -lpthread -lXi -ldl
+// command to compile and link on my environment (linux mint):
+// make bezier_curve.exec
 
 // execute:
-// ./bezier_curve.exec
+// ./bezier_curve.exec [--threads N] [--mode tables|simd|fd|casteljau] [--adaptive TOL] [--no-lod] [--strips] [--gpu-tessellation] [--gpu-compute] [--verify-gpu-compute] [--check-drag] [--compact-vertices] [--profile] [--profile-csv FILE] [--profile-frames N] [NI NJ [RES_I RES_J]]
 
 // drag and drop a control point to move it
 // use the arrow keys to rotate the view matrix
-// RES_I and RES_J define the resolution
+// NI and NJ define the degree of the patch (default 4 5), RES_I and RES_J the resolution (default NI * 10, NJ * 10)
 
 #include "./Points.cpp"
+#include "./Surface_patch.h"
+#include "./Adaptive_tessellator.h"
+#include "./Surface_lod.h"
+#include "./Gl_extensions.h"
+#include "./Frame_profiler.h"
+#include "./Gpu_timer.h"
+#include "./Alloc_counter.h"
 #include "./glad.h"
 #include "./Shader_s.h"
 #include "./stb_image.h"
-#include "./stb_image.cpp"
-#include "./glad.c"
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <glm/glm.hpp>
@@ -31,6 +33,10 @@ using namespace std;
 const char WINDOW_NAME[] = "beziér";
 const char VERTEX_SHADER_NAME[] = "bezier_shader.vertex";
 const char FRAGMENT_SHADER_NAME[] = "bezier_shader.fragment";
+const char PATCH_VERTEX_SHADER_NAME[] = "bezier_patch.vertex";
+const char PATCH_TESS_CONTROL_SHADER_NAME[] = "bezier_patch.tesscontrol";
+const char PATCH_TESS_EVALUATION_SHADER_NAME[] = "bezier_patch.tesseval";
+const char SURFACE_COMPUTE_SHADER_NAME[] = "bezier_surface.compute";
 const char AMBIENT_OCCLUSION_TEX_PATH[] = "./textures/lava/ambientocclusion.png";
 const char BASE_COLOR_TEX_PATH[] = "./textures/lava/basecolor.png";
 const char EMISSIVE_TEX_PATH[] = "./textures/lava/emissive.png";
@@ -42,27 +48,95 @@ const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
 #define MARKER_RADIUS 8
-
-#define NI 4
-#define NJ 5
-#define RES_I NI * 10
-#define RES_J NJ * 10
-
-float CP[NI][NJ][3];
-float outp[RES_I][RES_J][3];
+// coarser levels of the surface are drawn while their error stays below this many pixels
+#define LOD_PIXEL_TOLERANCE 0.5f
+#define ZOOM_STEP 1.1f
+// seconds between two updates of the profile shown in the window title
+#define PROFILE_OVERLAY_INTERVAL 0.5
+
+// the tessellation control shader passes patches of this many vertices, the minimum every
+// OpenGL 4.0 implementation supports, and the primitive generator splits an edge at most
+// MAX_TESS_LEVEL times
+#define MAX_GPU_PATCH_VERTICES 32
+#define MAX_TESS_LEVEL 64
+// the compute shader evaluates tiles of COMPUTE_GROUP_SIZE x COMPUTE_GROUP_SIZE samples and
+// keeps the bernstein rows of at most degree MAX_COMPUTE_DEGREE in registers
+#define COMPUTE_GROUP_SIZE 8
+#define MAX_COMPUTE_DEGREE 31
+// largest difference between the compute shader and the cpu evaluator --verify-gpu-compute accepts
+#define COMPUTE_VERIFY_TOLERANCE 1e-4f
+// largest difference between the patch behind the markers and the surface evaluated from
+// the markers themselves --check-drag accepts
+#define DRAG_CHECK_TOLERANCE 1e-4f
+
+#define DEFAULT_NI 4
+#define DEFAULT_NJ 5
+#define DEFAULT_RES_PER_DEGREE 10
+
+SurfacePatch patch(DEFAULT_NI, DEFAULT_NJ, DEFAULT_NI * DEFAULT_RES_PER_DEGREE, DEFAULT_NJ * DEFAULT_RES_PER_DEGREE);
+vector<unsigned int> surface_indices;
+SurfaceLod surface_lod;
+bool use_lod = true;
+// --gpu-tessellation draws the control net as one patch and evaluates the surface in the
+// tessellation shaders, a drag then only uploads the moved control point
+bool gpu_tessellation = false;
+// --gpu-compute evaluates the sample grid in a compute shader that writes the vertex buffer,
+// a drag then uploads the moved control point to the control net buffer and dispatches
+bool gpu_compute = false;
+bool verify_gpu_compute = false;
+bool check_drag = false;
+Shader *compute_shader = nullptr;
+unsigned int control_net_SSBO;
+// the cpu paths stream their vertices through a ring of buffer segments, the gpu paths write
+// or read the plain VBO
+bool use_streaming = true;
+StreamingBuffer stream;
+// --adaptive TOL replaces the fixed RES_I x RES_J grid with a quadtree tessellation
+bool adaptive_tessellation = false;
+AdaptiveTessellator tessellator;
+AdaptiveMesh adaptive_mesh;
+// --profile times the stages of every frame and shows their min/avg/p99 in milliseconds in the
+// window title, --profile-csv FILE also writes the times of every frame. the gpu stages are the
+// gpu time of the point and surface draws, measured with timer queries and recorded
+// GPU_TIMER_LATENCY frames after the draws they measured
+enum FrameStage
+{
+    STAGE_INPUT,
+    STAGE_UPDATE,
+    STAGE_UPLOAD,
+    STAGE_UNIFORMS,
+    STAGE_DRAW,
+    STAGE_SWAP,
+    STAGE_EVENTS,
+    STAGE_GPU_POINTS,
+    STAGE_GPU_SURFACE,
+};
+enum GpuPass
+{
+    GPU_PASS_POINTS,
+    GPU_PASS_SURFACE,
+};
+FrameProfiler profiler({"input", "update", "upload", "uniforms", "draw", "swap", "events", "gpu_points", "gpu_surface"});
+GpuTimer gpu_timer;
+const char *profile_csv_path = nullptr;
+// --profile-frames N closes the window after N frames, for unattended runs
+long profile_frames = 0;
 
 bool mouse_l_down = false;
 int selected = -1;
 bool already_added = false;
 bool draw_bezier_surface = false;
+// --strips draws the grid as one triangle strip per row instead of two triangles per cell
+bool draw_triangle_strips = false;
 bool rotate_left = false;
 bool rotate_right = false;
 bool rotate_up = false;
 bool rotate_down = false;
 
 GLFWwindow *window;
-float vertices[INFO_PER_POINT * MAX_NO_POINTS] = {};
-unsigned int VBO, VAO;
+unsigned int VBO, VAO, EBO;
+// points the vertex buffer currently has room for
+int vertex_buffer_capacity = 0;
 glm::mat4 model = glm::mat4(1.0f);
 glm::mat4 view = glm::mat4(1.0f);
 glm::mat4 projection = glm::mat4(1.0f);
@@ -71,18 +145,33 @@ glm::mat4 projection = glm::mat4(1.0f);
 
 int setupGlfwAndGlad();
 void setupGL();
+void ensure_vertex_buffer_capacity();
 unsigned int load_texture(const char *path);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 void mouse_callback(GLFWwindow *window, int button, int action, int mods);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
+void scroll_callback(GLFWwindow *window, double x_offset, double y_offset);
 void processInput(GLFWwindow *window);
 void handleMouseDown();
 glm::vec2 convert_mouse_coord_to_world(float x, float y);
 bool mouse_on_point(glm::vec2 mouse, glm::vec3 point);
-void quad(unsigned int &VBO, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d);
-float blend(int k, float mu, int n);
-void bezier_surface(unsigned int &VBO, int NUMI, int NUMJ);
-void generate_points(unsigned int &VBO, int NUMI, int NUMJ);
+bool parse_patch_args(int argc, char **argv);
+glm::vec3 patch_to_marker(const float *p);
+glm::vec3 marker_to_patch(glm::vec3 position);
+void drag_control_point(int marker, glm::vec3 new_position);
+bool check_drag_consistency();
+glm::vec3 surface_vertex(int i, int j);
+glm::vec3 surface_normal(int i, int j);
+void build_surface_indices(unsigned int &EBO);
+void upload_surface_indices(unsigned int &EBO);
+void bezier_surface();
+void adaptive_bezier_surface();
+void upload_control_net();
+void dispatch_surface_evaluation();
+bool verify_compute_surface();
+void update_bezier_surface(int ci, int cj, glm::vec3 delta);
+void reevaluate_bezier_surface();
+void generate_points();
 
 //
 //
@@ -90,13 +179,30 @@ void generate_points(unsigned int &VBO, int NUMI, int NUMJ);
 //
 //
 
-int main()
+int main(int argc, char **argv)
 {
+    if (!parse_patch_args(argc, argv))
+    {
+        return -1;
+    }
+    // the control points and the sample grid are allocated once up front, the vertex buffer
+    // is created with the same capacity
+    points.reserve(patch.num_control_points() + patch.num_samples());
 
     if (setupGlfwAndGlad() == -1)
     {
         return -1;
     }
+    if (profile_csv_path != nullptr && !profiler.open_csv(profile_csv_path))
+    {
+        std::cout << "can not write " << profile_csv_path << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    if (profiler.enabled)
+    {
+        gpu_timer.create(profiler, {STAGE_GPU_POINTS, STAGE_GPU_SURFACE});
+    }
 
     setupGL();
 
@@ -107,11 +213,55 @@ int main()
     lava_shader.setInt("material.base", 0);
     lava_shader.setInt("material.emission", 1);
 
-    generate_points(VBO, NI, NJ);
+    Shader *patch_shader = nullptr;
+    if (gpu_tessellation)
+    {
+        patch_shader = new Shader(PATCH_VERTEX_SHADER_NAME, FRAGMENT_SHADER_NAME, nullptr, PATCH_TESS_CONTROL_SHADER_NAME, PATCH_TESS_EVALUATION_SHADER_NAME);
+        patch_shader->use();
+        patch_shader->setInt("material.base", 0);
+        patch_shader->setInt("material.emission", 1);
+    }
+    if (gpu_compute)
+    {
+        compute_shader = new Shader(SURFACE_COMPUTE_SHADER_NAME);
+        glGenBuffers(1, &control_net_SSBO);
+    }
+
+    generate_points();
+
+    // headless check of the compute shader against the cpu evaluator, no frame is drawn
+    if (verify_gpu_compute)
+    {
+        bool matches = gpu_compute && verify_compute_surface();
+        delete compute_shader;
+        glfwTerminate();
+        return matches ? 0 : 1;
+    }
+    // headless check that a drag keeps the markers and the patch behind them in step, no
+    // frame is drawn
+    if (check_drag)
+    {
+        bool matches = check_drag_consistency();
+        delete patch_shader;
+        delete compute_shader;
+        glfwTerminate();
+        return matches ? 0 : 1;
+    }
 
+    double last_overlay_update = 0;
+    long frames_drawn = 0;
     while (!glfwWindowShouldClose(window))
     {
-        processInput(window);
+#ifndef NDEBUG
+        unsigned long allocations_before = heap_allocations();
+#endif
+        profiler.begin_frame();
+        gpu_timer.begin_frame();
+        points.buffer_uploads = 0;
+        {
+            ProfileZone zone(profiler, STAGE_INPUT);
+            processInput(window);
+        }
 
         glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -121,51 +271,176 @@ int main()
         // projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         // model = glm::translate(model, cubePositions[i]);
 
-        if (mouse_l_down)
         {
-            handleMouseDown();
+            // a drag evaluates the surface here
+            ProfileZone zone(profiler, STAGE_UPDATE);
+            if (draw_bezier_surface)
+            {
+                draw_bezier_surface = false;
+                reevaluate_bezier_surface();
+            }
+            if (mouse_l_down)
+            {
+                handleMouseDown();
+            }
+            else if (rotate_left)
+            {
+                view = glm::rotate(view, 0.02f, glm::vec3(0.0f, 1.0f, 0.0f));
+            }
+            else if (rotate_right)
+            {
+                view = glm::rotate(view, -0.02f, glm::vec3(0.0f, 1.0f, 0.0f));
+            }
+            else if (rotate_up)
+            {
+                view = glm::rotate(view, 0.02f, glm::vec3(1.0f, 0.0f, 0.0f));
+            }
+            else if (rotate_down)
+            {
+                view = glm::rotate(view, -0.02f, glm::vec3(1.0f, 0.0f, 0.0f));
+            }
+        }
+
+        {
+            // one upload per frame for everything the input handling changed
+            ProfileZone zone(profiler, STAGE_UPLOAD);
+            ensure_vertex_buffer_capacity();
+            if (use_streaming)
+            {
+                points.flush_to_stream(stream);
+            }
+            else
+            {
+                points.flush_to_buffer(VBO);
+            }
+        }
+        int base_vertex = use_streaming ? stream.base_vertex(points.vertex_size()) : 0;
+
+        {
+            ProfileZone zone(profiler, STAGE_UNIFORMS);
+            glActiveTexture(GL_TEXTURE0);
+            lava_shader.use();
+            glBindVertexArray(VAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, baseMap);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, emissionMap);
+
+            lava_shader.setMat4("model", model);
+            lava_shader.setMat4("view", view);
+            lava_shader.setMat4("projection", projection);
         }
-        else if (rotate_left)
+
         {
-            view = glm::rotate(view, 0.02f, glm::vec3(0.0f, 1.0f, 0.0f));
+            ProfileZone zone(profiler, STAGE_DRAW);
+            glPointSize(8);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            gpu_timer.begin(GPU_PASS_POINTS);
+            glDrawArrays(GL_POINTS, base_vertex, patch.num_control_points());
+            gpu_timer.end(GPU_PASS_POINTS);
+            glPointSize(3);
+            if (gpu_tessellation)
+            {
+                // the control point markers are the patch, in the same space as the cpu surface
+                patch_shader->use();
+                patch_shader->setMat4("model", model);
+                patch_shader->setMat4("view", view);
+                patch_shader->setMat4("projection", projection);
+                patch_shader->setInt("ni", patch.ni);
+                patch_shader->setInt("nj", patch.nj);
+                patch_shader->setVec2("tex_scale", float(patch.res_i - 1), float(patch.res_j - 1));
+                patch_shader->setVec2("tess_level", float(min(patch.res_i - 1, MAX_TESS_LEVEL)), float(min(patch.res_j - 1, MAX_TESS_LEVEL)));
+                glPatchParameteri_(GL_PATCH_VERTICES, patch.num_control_points());
+                gpu_timer.begin(GPU_PASS_SURFACE);
+                glDrawArrays(GL_PATCHES, 0, patch.num_control_points());
+                gpu_timer.end(GPU_PASS_SURFACE);
+            }
+            else
+            {
+                GLsizei surface_count = (GLsizei)surface_indices.size();
+                size_t surface_first = 0;
+                if (use_lod && !adaptive_tessellation)
+                {
+                    // the adaptive mesh already follows the shape, only the grid has coarser levels
+                    if (surface_lod.errors_stale)
+                    {
+                        float scale[3] = {1.0f / patch.ni, 1.0f / patch.nj, 1.0f};
+                        float offset[3] = {-0.5f, -0.5f, 0.0f};
+                        surface_lod.update_errors(patch.samples(), scale, offset);
+                    }
+                    glm::mat4 mvp = projection * view * model;
+                    const LodLevel &level = surface_lod.select(glm::value_ptr(mvp), SCR_WIDTH, SCR_HEIGHT, LOD_PIXEL_TOLERANCE);
+                    surface_first = level.first_index;
+                    surface_count = level.num_indices;
+                }
+                gpu_timer.begin(GPU_PASS_SURFACE);
+                glDrawElementsBaseVertex(draw_triangle_strips && !adaptive_tessellation ? GL_TRIANGLE_STRIP : GL_TRIANGLES, surface_count, GL_UNSIGNED_INT, (void *)(surface_first * sizeof(unsigned int)), base_vertex);
+                gpu_timer.end(GPU_PASS_SURFACE);
+            }
+            if (use_streaming)
+            {
+                stream.end_frame();
+            }
+            gpu_timer.end_frame();
         }
-        else if (rotate_right)
+
         {
-            view = glm::rotate(view, -0.02f, glm::vec3(0.0f, 1.0f, 0.0f));
+            ProfileZone zone(profiler, STAGE_SWAP);
+            glfwSwapBuffers(window);
         }
-        else if (rotate_up)
+#ifndef NDEBUG
+        // a whole drag frame, input to swap, must not touch the heap, and the events that follow
+        // may select or release a point. the adaptive mesh reuses its storage, only a mesh
+        // bigger than any before it grows the buffers
+        if (selected != -1 && heap_allocations() != allocations_before)
         {
-            view = glm::rotate(view, 0.02f, glm::vec3(1.0f, 0.0f, 0.0f));
+            std::cout << "drag frame performed " << heap_allocations() - allocations_before << " heap allocations" << std::endl;
         }
-        else if (rotate_down)
+        // and everything it changed reaches the vertex buffer in one upload
+        if (selected != -1 && points.buffer_uploads > 1)
         {
-            view = glm::rotate(view, -0.02f, glm::vec3(1.0f, 0.0f, 0.0f));
+            std::cout << "drag frame performed " << points.buffer_uploads << " vertex buffer uploads" << std::endl;
         }
+#endif
+        {
+            // clicks and key presses run their callbacks in here
+            ProfileZone zone(profiler, STAGE_EVENTS);
+            glfwPollEvents();
+        }
+        profiler.end_frame();
+        if (profiler.enabled && glfwGetTime() - last_overlay_update >= PROFILE_OVERLAY_INTERVAL)
+        {
+            glfwSetWindowTitle(window, (string(WINDOW_NAME) + "  " + profiler.summary()).c_str());
+            last_overlay_update = glfwGetTime();
+        }
+        if (profile_frames > 0 && ++frames_drawn >= profile_frames)
+        {
+            glfwSetWindowShouldClose(window, true);
+        }
+    }
 
-        glActiveTexture(GL_TEXTURE0);
-        lava_shader.use();
-        glBindVertexArray(VAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, baseMap);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, emissionMap);
-
-        lava_shader.setMat4("model", model);
-        lava_shader.setMat4("view", view);
-        lava_shader.setMat4("projection", projection);
-
-        glPointSize(8);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glDrawArrays(GL_POINTS, 0, (NI + 1) * (NJ + 1));
-        glPointSize(3);
-        glDrawArrays(GL_TRIANGLES, (NI + 1) * (NJ + 1), points.num_points - ((NI + 1) * (NJ + 1)));
-
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    if (profiler.enabled)
+    {
+        std::cout << "min/avg/p99 ms: " << profiler.summary() << std::endl;
+        if (gpu_timer.dropped > 0)
+        {
+            std::cout << gpu_timer.dropped << " gpu timings were not ready after " << GPU_TIMER_LATENCY << " frames and were dropped" << std::endl;
+        }
+        gpu_timer.destroy();
     }
 
+    delete patch_shader;
+    delete compute_shader;
     glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    if (use_streaming)
+    {
+        stream.destroy();
+    }
+    else
+    {
+        glDeleteBuffers(1, &VBO);
+    }
+    glDeleteBuffers(1, &EBO);
 
     glfwTerminate();
     return 0;
@@ -180,11 +455,29 @@ int main()
 int setupGlfwAndGlad()
 {
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, WINDOW_NAME, NULL, NULL);
+    // tessellation shaders need 4.0 and compute shaders 4.3
+    window = NULL;
+    if (gpu_tessellation || gpu_compute)
+    {
+        int minor = gpu_compute ? 3 : 0;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, WINDOW_NAME, NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "no OpenGL 4." << minor << " context, the surface is evaluated on the cpu" << std::endl;
+            gpu_tessellation = false;
+            gpu_compute = false;
+        }
+    }
+    if (window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, WINDOW_NAME, NULL, NULL);
+    }
 
     if (window == NULL)
     {
@@ -197,6 +490,7 @@ int setupGlfwAndGlad()
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetMouseButtonCallback(window, mouse_callback);
     glfwSetKeyCallback(window, key_callback);
+    glfwSetScrollCallback(window, scroll_callback);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
@@ -204,6 +498,18 @@ int setupGlfwAndGlad()
         return -1;
     }
 
+    load_gl_extensions((GLADloadproc)glfwGetProcAddress);
+    if (gpu_tessellation && glPatchParameteri_ == nullptr)
+    {
+        std::cout << "the context has no tessellation shaders, the surface is evaluated on the cpu" << std::endl;
+        gpu_tessellation = false;
+    }
+    if (gpu_compute && (glDispatchCompute_ == nullptr || glMemoryBarrier_ == nullptr))
+    {
+        std::cout << "the context has no compute shaders, the surface is evaluated on the cpu" << std::endl;
+        gpu_compute = false;
+    }
+
     return 0;
 }
 
@@ -218,22 +524,67 @@ void setupGL()
     glEnable(GL_DEPTH_TEST);
 
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
 
     glBindVertexArray(VAO);
 
+    use_streaming = !gpu_tessellation && !gpu_compute;
+    if (use_streaming)
+    {
+        stream.create(points.capacity() * points.vertex_size());
+        VBO = stream.buffer;
+        std::cout << (stream.persistent ? "streaming vertices through persistently mapped segments" : "streaming vertices by orphaning the buffer") << std::endl;
+    }
+    else
+    {
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, points.capacity() * points.vertex_size(), nullptr, GL_STATIC_DRAW);
+    }
+    vertex_buffer_capacity = points.capacity();
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, INFO_PER_POINT * points.primitive_size, (void *)0);
-    glEnableVertexAttribArray(0);
-    // normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, INFO_PER_POINT * points.primitive_size, (void *)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // texture coordinates
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, INFO_PER_POINT * points.primitive_size, (void *)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    // the element buffer binding is part of the VAO state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    // only used by the triangle strip mode, one strip per grid row
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(PRIMITIVE_RESTART_INDEX);
+
+    // position, normal and texture coordinates
+    setup_vertex_attributes(points.format);
+}
+
+// the vertex buffer follows the point pool when it grew. the gpu copies the old contents,
+// including whatever the compute shader wrote, into the larger buffer
+void ensure_vertex_buffer_capacity()
+{
+    if (points.capacity() <= vertex_buffer_capacity)
+    {
+        return;
+    }
+    size_t size = points.capacity() * points.vertex_size();
+    if (use_streaming)
+    {
+        stream.grow(size);
+        VBO = stream.buffer;
+    }
+    else
+    {
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, vertex_buffer_capacity * points.vertex_size());
+        glDeleteBuffers(1, &VBO);
+        VBO = grown;
+    }
+    vertex_buffer_capacity = points.capacity();
+
+    // the attribute pointers of the VAO still name the old buffer
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    setup_vertex_attributes(points.format);
 }
 
 //
@@ -251,7 +602,7 @@ unsigned int load_texture(char const *path)
     unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
     if (data)
     {
-        GLenum format;
+        GLenum format = GL_RGB;
         if (nrComponents == 1)
             format = GL_RED;
         else if (nrComponents == 3)
@@ -318,12 +669,12 @@ void mouse_callback(GLFWwindow *window, int button, int action, int mods)
     {
         double x, y;
         glfwGetCursorPos(window, &x, &y);
+        glm::vec2 mouse = convert_mouse_coord_to_world(float(x), float(y));
         for (int i = 0; i < points.num_points; i++)
         {
-            Points::Point point = points.points[i];
-            if (mouse_on_point(convert_mouse_coord_to_world(float(x), float(y)), point.position))
+            if (mouse_on_point(mouse, points.geometry[i].position))
             {
-                selected = point.index;
+                selected = points.metadata[i].index;
                 break;
             }
         }
@@ -372,6 +723,13 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     }
 }
 
+// the wheel zooms the whole scene, zooming out lets the surface drop to coarser levels
+void scroll_callback(GLFWwindow *window, double x_offset, double y_offset)
+{
+    float factor = y_offset > 0 ? ZOOM_STEP : 1.0f / ZOOM_STEP;
+    projection = glm::scale(projection, glm::vec3(factor, factor, 1.0f));
+}
+
 void handleMouseDown()
 {
     double x, y;
@@ -379,27 +737,34 @@ void handleMouseDown()
     glm::vec2 pos = convert_mouse_coord_to_world(float(x), float(y));
     if (!already_added && selected == -1)
     {
-        points.add_point(VBO, Points::Point(glm::vec3(pos.x, pos.y, 0.0f)));
+        points.add_point(Points::Point(glm::vec3(pos.x, pos.y, 0.0f)));
         already_added = true;
     }
-    else if (mouse_l_down && selected != -1 && selected < (NI + 1) * (NJ + 1))
+    else if (mouse_l_down && selected != -1 && selected < patch.num_control_points())
     {
-        Points::Point selected_p = points.points[selected];
-        glm::vec3 old_position = selected_p.position;
+        glm::vec3 old_position = points.geometry[selected].position;
         glm::vec2 new_position_x_y = convert_mouse_coord_to_world(x, y);
         glm::vec3 new_position = glm::vec3(new_position_x_y.x, new_position_x_y.y, 0.0f);
-        glm::vec3 offset = new_position - old_position;
-        points.modify_point_position_in_buffer(VBO, selected, new_position);
-        int selected_i = selected_p.i_in_CP_array;
-        int selected_j = selected_p.j_in_CP_array;
-        CP[selected_i][selected_j][0] = new_position.x;
-        CP[selected_i][selected_j][1] = new_position.y;
-        CP[selected_i][selected_j][2] = new_position.z;
-        points.num_points = (NI + 1) * (NJ + 1);
-        bezier_surface(VBO, NI, NJ);
+        if (new_position == old_position)
+        {
+            return;
+        }
+        drag_control_point(selected, new_position);
     }
 }
 
+// moves a control point marker and the control point of the patch behind it. the marker is
+// in drawing space, the delta every evaluation path applies to the patch is in patch space
+void drag_control_point(int marker, glm::vec3 new_position)
+{
+    points.modify_point_position(marker, new_position);
+    int ci = points.metadata[marker].i_in_CP_array;
+    int cj = points.metadata[marker].j_in_CP_array;
+    float *cp = patch.control_point(ci, cj);
+    glm::vec3 delta = marker_to_patch(new_position) - glm::vec3(cp[0], cp[1], cp[2]);
+    update_bezier_surface(ci, cj, delta);
+}
+
 glm::vec2 convert_mouse_coord_to_world(float x, float y)
 {
     glm::vec4 pos_4d = projection * model * view * glm::vec4(x, y, 0.0f, 0.0f);
@@ -420,118 +785,466 @@ bool mouse_on_point(glm::vec2 mouse, glm::vec3 point)
 //
 //
 
-void quad(unsigned int &VBO, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d)
+// optional command line arguments: [--threads N] [--mode tables|simd|fd|casteljau] [--adaptive TOL] [--no-lod] [--strips] [--gpu-tessellation] [--gpu-compute] [--verify-gpu-compute] [--check-drag] [--compact-vertices] [--profile] [--profile-csv FILE] [--profile-frames N] NI NJ [RES_I RES_J]
+bool parse_patch_args(int argc, char **argv)
 {
-    glm::vec3 u = b - a;
-    glm::vec3 v = c - b;
+    vector<int> sizes;
+    for (int a = 1; a < argc; a++)
+    {
+        if (string(argv[a]) == "--threads" && a + 1 < argc)
+        {
+            patch.set_num_threads(atoi(argv[++a]));
+        }
+        else if (string(argv[a]) == "--mode" && a + 1 < argc)
+        {
+            string mode = argv[++a];
+            if (mode == "tables")
+                patch.mode = EVAL_BASIS_TABLES;
+            else if (mode == "simd")
+                patch.mode = EVAL_SIMD_BATCH;
+            else if (mode == "fd")
+                patch.mode = EVAL_FORWARD_DIFFERENCES;
+            else if (mode == "casteljau")
+            {
+                patch.mode = EVAL_DE_CASTELJAU;
+                patch.de_casteljau_double = true;
+            }
+            else
+            {
+                std::cout << "unknown evaluation mode " << mode << std::endl;
+                return false;
+            }
+        }
+        else if (string(argv[a]) == "--gpu-tessellation")
+        {
+            gpu_tessellation = true;
+        }
+        else if (string(argv[a]) == "--gpu-compute")
+        {
+            gpu_compute = true;
+        }
+        else if (string(argv[a]) == "--verify-gpu-compute")
+        {
+            gpu_compute = true;
+            verify_gpu_compute = true;
+        }
+        else if (string(argv[a]) == "--check-drag")
+        {
+            check_drag = true;
+        }
+        else if (string(argv[a]) == "--compact-vertices")
+        {
+            points.format = VERTEX_COMPACT;
+        }
+        else if (string(argv[a]) == "--profile")
+        {
+            profiler.enabled = true;
+        }
+        else if (string(argv[a]) == "--profile-csv" && a + 1 < argc)
+        {
+            profiler.enabled = true;
+            profile_csv_path = argv[++a];
+        }
+        else if (string(argv[a]) == "--profile-frames" && a + 1 < argc)
+        {
+            profiler.enabled = true;
+            profile_frames = atol(argv[++a]);
+        }
+        else if (string(argv[a]) == "--no-lod")
+        {
+            use_lod = false;
+        }
+        else if (string(argv[a]) == "--strips")
+        {
+            draw_triangle_strips = true;
+        }
+        else if (string(argv[a]) == "--adaptive" && a + 1 < argc)
+        {
+            adaptive_tessellation = true;
+            tessellator.tolerance = atof(argv[++a]);
+            if (tessellator.tolerance <= 0)
+            {
+                std::cout << "the adaptive tolerance must be positive" << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            sizes.push_back(atoi(argv[a]));
+        }
+    }
+    if (int(gpu_tessellation) + int(gpu_compute) + int(adaptive_tessellation) > 1)
+    {
+        std::cout << "--adaptive, --gpu-tessellation and --gpu-compute exclude each other" << std::endl;
+        return false;
+    }
+    // the level errors come from the cpu samples, which the compute path does not produce, and
+    // the compute shader writes float vertices
+    if (gpu_compute)
+    {
+        use_lod = false;
+        points.format = VERTEX_FLOAT;
+    }
+    if (sizes.empty())
+    {
+        return true;
+    }
+    if (sizes.size() != 2 && sizes.size() != 4)
+    {
+        std::cout << "usage: " << argv[0] << " [--threads N] [--mode tables|simd|fd|casteljau] [NI NJ [RES_I RES_J]]" << std::endl;
+        return false;
+    }
+
+    int ni = sizes[0];
+    int nj = sizes[1];
+    int res_i = sizes.size() == 4 ? sizes[2] : ni * DEFAULT_RES_PER_DEGREE;
+    int res_j = sizes.size() == 4 ? sizes[3] : nj * DEFAULT_RES_PER_DEGREE;
+    if (ni < 1 || nj < 1 || res_i < 2 || res_j < 2)
+    {
+        std::cout << "degrees must be at least 1 and resolutions at least 2" << std::endl;
+        return false;
+    }
+
+    if (gpu_compute && max(ni, nj) > MAX_COMPUTE_DEGREE)
+    {
+        std::cout << "the compute shader evaluates degrees up to " << MAX_COMPUTE_DEGREE << ", the surface is evaluated on the cpu" << std::endl;
+        gpu_compute = false;
+    }
+    if (gpu_tessellation && (ni + 1) * (nj + 1) > MAX_GPU_PATCH_VERTICES)
+    {
+        std::cout << "a control net of more than " << MAX_GPU_PATCH_VERTICES << " points does not fit in one patch, the surface is evaluated on the cpu" << std::endl;
+        gpu_tessellation = false;
+    }
 
-    glm::vec3 normal = glm::normalize(glm::cross(u, v));
+    patch.resize(ni, nj, res_i, res_j);
+    return true;
+}
 
-    points.add_point(VBO, Points::Point(a, normal, glm::vec2(-1.0, -1.0)));
-    points.add_point(VBO, Points::Point(b, normal, glm::vec2(1.0, -1.0)));
-    points.add_point(VBO, Points::Point(c, normal, glm::vec2(1.0, 1.0)));
-    points.add_point(VBO, Points::Point(a, normal, glm::vec2(-1.0, -1.0)));
-    points.add_point(VBO, Points::Point(c, normal, glm::vec2(1.0, 1.0)));
-    points.add_point(VBO, Points::Point(d, normal, glm::vec2(-1.0, 1.0)));
+// a point of the patch in the space the control point markers are drawn in, the patch spans
+// [0, ni] x [0, nj] and is centered on the origin
+glm::vec3 patch_to_marker(const float *p)
+{
+    return glm::vec3(p[0] / patch.ni - 0.5f, p[1] / patch.nj - 0.5f, p[2]);
 }
 
-float blend(int k, float mu, int n)
+glm::vec3 marker_to_patch(glm::vec3 position)
 {
-    int nn, kn, nkn;
-    float blend = 1;
+    return glm::vec3((position.x + 0.5f) * patch.ni, (position.y + 0.5f) * patch.nj, position.z);
+}
 
-    nn = n;
-    kn = k;
-    nkn = n - k;
+// sample (i, j) of the patch mapped to the same space as the control point markers
+glm::vec3 surface_vertex(int i, int j)
+{
+    return patch_to_marker(patch.sample(i, j));
+}
+
+// normal at sample (i, j) from the partial derivatives the patch evaluated with it, scaled
+// like surface_vertex(). where the surface is degenerate (e.g. a collapsed edge of the control
+// net) the derivatives vanish and central differences of the neighbouring samples are used
+glm::vec3 surface_normal(int i, int j)
+{
+    const float *su = patch.sample_du(i, j);
+    const float *sv = patch.sample_dv(i, j);
+    glm::vec3 du = glm::vec3(su[0] / patch.ni, su[1] / patch.nj, su[2]);
+    glm::vec3 dv = glm::vec3(sv[0] / patch.ni, sv[1] / patch.nj, sv[2]);
+    glm::vec3 normal = glm::cross(du, dv);
+
+    if (glm::length(normal) < 1e-12f)
+    {
+        du = surface_vertex(min(i + 1, patch.res_i - 1), j) - surface_vertex(max(i - 1, 0), j);
+        dv = surface_vertex(i, min(j + 1, patch.res_j - 1)) - surface_vertex(i, max(j - 1, 0));
+        normal = glm::cross(du, dv);
+    }
+    return glm::normalize(normal);
+}
+
+// indices into the shared sample grid that follows the control points in the vertex buffer,
+// for the full grid and every coarser level of detail after it
+void build_surface_indices(unsigned int &EBO)
+{
+    surface_lod.build(patch.res_i, patch.res_j, patch.num_control_points(), draw_triangle_strips);
+    surface_indices = surface_lod.indices;
+    upload_surface_indices(EBO);
+}
+
+void upload_surface_indices(unsigned int &EBO)
+{
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, surface_indices.size() * sizeof(unsigned int), surface_indices.data(), GL_STATIC_DRAW);
+}
+
+void bezier_surface()
+{
+    int i, j;
 
-    while (nn >= 1)
+    // the tessellation shaders evaluate the surface from the control point markers
+    if (gpu_tessellation)
     {
-        blend *= float(nn);
-        nn--;
-        if (kn > 1)
+        return;
+    }
+    if (gpu_compute)
+    {
+        if (patch.update_basis() || surface_indices.empty())
         {
-            blend /= float(kn);
-            kn--;
+            build_surface_indices(EBO);
         }
-        if (nkn > 1)
+        // the samples only exist in the vertex buffer, their range of the pool stays reserved
+        // so that nothing else is written over them
+        points.reserve(patch.num_control_points() + patch.num_samples());
+        points.num_points = patch.num_control_points() + patch.num_samples();
+        ensure_vertex_buffer_capacity();
+        upload_control_net();
+        dispatch_surface_evaluation();
+        return;
+    }
+    if (adaptive_tessellation)
+    {
+        adaptive_bezier_surface();
+        return;
+    }
+
+    // the basis tables and the index buffer are only rebuilt when the degree or resolution changes
+    if (patch.update_basis() || surface_indices.empty())
+    {
+        build_surface_indices(EBO);
+    }
+    patch.evaluate();
+    surface_lod.errors_stale = true;
+
+    // every sample is emitted once, texture coordinates step by 2 per cell like the old per-quad corners
+    for (i = 0; i < patch.res_i; i++)
+    {
+        for (j = 0; j < patch.res_j; j++)
         {
-            blend /= float(nkn);
-            nkn--;
+            glm::vec2 tex = glm::vec2(2.0f * i - 1.0f, 2.0f * j - 1.0f);
+            points.add_point(Points::Point(surface_vertex(i, j), surface_normal(i, j), tex));
         }
     }
-    if (k > 0)
+}
+
+// the quadtree mesh is rebuilt as a whole, its vertex count and connectivity change with the
+// shape. texture coordinates use the same density as the grid at RES_I x RES_J
+void adaptive_bezier_surface()
+{
+    unsigned int surface_start = patch.num_control_points();
+    tessellator.tessellate(patch, adaptive_mesh);
+    points.reserve(surface_start + adaptive_mesh.num_vertices());
+
+    points.num_points = surface_start;
+    for (int v = 0; v < adaptive_mesh.num_vertices(); v++)
     {
-        blend *= float(pow(mu, k));
+        const float *p = &adaptive_mesh.positions[v * 3];
+        const float *su = &adaptive_mesh.du[v * 3];
+        const float *sv = &adaptive_mesh.dv[v * 3];
+        float u = adaptive_mesh.uv[v * 2], w = adaptive_mesh.uv[v * 2 + 1];
+
+        glm::vec3 position = glm::vec3(p[0] / patch.ni - 0.5f, p[1] / patch.nj - 0.5f, p[2]);
+        glm::vec3 du = glm::vec3(su[0] / patch.ni, su[1] / patch.nj, su[2]);
+        glm::vec3 dv = glm::vec3(sv[0] / patch.ni, sv[1] / patch.nj, sv[2]);
+        glm::vec3 normal = glm::cross(du, dv);
+        if (glm::length(normal) < 1e-12f)
+        {
+            // degenerate corner or edge, take the derivatives a little towards the middle
+            float q[3], qu[3], qv[3];
+            patch.evaluate_point(u + (0.5f - u) * 1e-3f, w + (0.5f - w) * 1e-3f, q, qu, qv);
+            normal = glm::cross(glm::vec3(qu[0] / patch.ni, qu[1] / patch.nj, qu[2]), glm::vec3(qv[0] / patch.ni, qv[1] / patch.nj, qv[2]));
+        }
+        glm::vec2 tex = glm::vec2(2.0f * u * (patch.res_i - 1) - 1.0f, 2.0f * w * (patch.res_j - 1) - 1.0f);
+        points.add_point(Points::Point(position, glm::normalize(normal), tex));
     }
-    if (n - k > 0)
+
+    surface_indices.resize(adaptive_mesh.indices.size());
+    for (size_t k = 0; k < adaptive_mesh.indices.size(); k++)
     {
-        blend *= float(pow(1 - mu, n - k));
+        surface_indices[k] = surface_start + adaptive_mesh.indices[k];
     }
-    return blend;
+    upload_surface_indices(EBO);
 }
 
-void bezier_surface(unsigned int &VBO, int NUMI, int NUMJ)
+// the surface is linear in its control points, so moving CP[ci][cj] by delta moves
+// every sample by delta * B_ci(mui) * B_cj(muj). the patch applies that rank-1 update to the
+// samples and their derivatives, then only the affected grid vertices are rewritten and
+// marked for the next upload
+void update_bezier_surface(int ci, int cj, glm::vec3 delta)
 {
-    int i, j, ki, kj;
-    float mui, muj, bi, bj;
+    int i, j, i_min, i_max, j_min, j_max;
+    float d[3] = {delta.x, delta.y, delta.z};
 
-    for (i = 0; i < RES_I; i++)
+    if (gpu_tessellation || gpu_compute || adaptive_tessellation)
     {
-        mui = float(i) / (RES_I - 1);
-        for (j = 0; j < RES_J; j++)
+        float *cp = patch.control_point(ci, cj);
+        cp[0] += d[0];
+        cp[1] += d[1];
+        cp[2] += d[2];
+        if (gpu_compute)
+        {
+            // 12 bytes of control net instead of the rewritten samples
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, control_net_SSBO);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, (ci * (patch.nj + 1) + cj) * 3 * sizeof(float), 3 * sizeof(float), cp);
+            dispatch_surface_evaluation();
+        }
+        if (adaptive_tessellation)
         {
-            muj = float(j) / (RES_J - 1);
+            adaptive_bezier_surface();
+        }
+        return;
+    }
 
-            outp[i][j][0] = 0;
-            outp[i][j][1] = 0;
-            outp[i][j][2] = 0;
-            for (ki = 0; ki <= NUMI; ki++)
-            {
-                bi = blend(ki, mui, NUMI);
-                for (kj = 0; kj <= NUMJ; kj++)
-                {
-                    bj = blend(kj, muj, NUMJ);
-                    outp[i][j][0] += (CP[ki][kj][0] * bi * bj);
-                    outp[i][j][1] += (CP[ki][kj][1] * bi * bj);
-                    outp[i][j][2] += (CP[ki][kj][2] * bi * bj);
-                }
-            }
+    // drop points added by clicking on empty space, the surface follows the control points
+    points.num_points = patch.num_control_points() + patch.num_samples();
+
+    if (!patch.apply_delta(ci, cj, d, i_min, i_max, j_min, j_max))
+    {
+        return;
+    }
+
+    int surface_start = patch.num_control_points();
+    surface_lod.errors_stale = true;
+
+    for (i = i_min; i <= i_max; i++)
+    {
+        for (j = j_min; j <= j_max; j++)
+        {
+            Points::Vertex &vertex = points.geometry[surface_start + i * patch.res_j + j];
+            vertex.position = surface_vertex(i, j);
+            vertex.normal = surface_normal(i, j);
         }
     }
 
-    for (i = 0; i < RES_I - 1; i++)
+    int first = surface_start + i_min * patch.res_j + j_min;
+    int last = surface_start + i_max * patch.res_j + j_max + 1;
+    points.mark_dirty(first, last - first);
+}
+
+// every incremental update rounds again, so once the mouse is released the grid is evaluated
+// from the control net and rewritten in place
+void reevaluate_bezier_surface()
+{
+    if (gpu_tessellation || gpu_compute || adaptive_tessellation)
+    {
+        return;
+    }
+    patch.evaluate();
+    surface_lod.errors_stale = true;
+
+    int surface_start = patch.num_control_points();
+    for (int i = 0; i < patch.res_i; i++)
     {
-        for (j = 0; j < RES_J - 1; j++)
+        for (int j = 0; j < patch.res_j; j++)
         {
-            glm::vec3 a = glm::vec3(outp[i][j][0] / NUMI - 0.5f, outp[i][j][1] / NUMJ - 0.5f, outp[i][j][2]);
-            glm::vec3 b = glm::vec3(outp[i][j + 1][0] / NUMI - 0.5f, outp[i][j + 1][1] / NUMJ - 0.5f, outp[i][j + 1][2]);
-            glm::vec3 c = glm::vec3(outp[i + 1][j][0] / NUMI - 0.5f, outp[i + 1][j][1] / NUMJ - 0.5f, outp[i + 1][j][2]);
-            glm::vec3 d = glm::vec3(outp[i + 1][j + 1][0] / NUMI - 0.5f, outp[i + 1][j + 1][1] / NUMJ - 0.5f, outp[i + 1][j + 1][2]);
-            quad(VBO, a, c, d, b);
+            Points::Vertex &vertex = points.geometry[surface_start + i * patch.res_j + j];
+            vertex.position = surface_vertex(i, j);
+            vertex.normal = surface_normal(i, j);
         }
     }
+    points.mark_dirty(surface_start, patch.num_samples());
+}
+
+void upload_control_net()
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, control_net_SSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, patch.num_control_points() * 3 * sizeof(float), patch.control_net(), GL_DYNAMIC_DRAW);
+}
+
+// the compute shader writes position, normal and texture coordinate of every sample straight
+// into the vertex buffer, in the same layout and space as bezier_surface() on the cpu
+void dispatch_surface_evaluation()
+{
+    compute_shader->use();
+    compute_shader->setInt("ni", patch.ni);
+    compute_shader->setInt("nj", patch.nj);
+    compute_shader->setInt("res_i", patch.res_i);
+    compute_shader->setInt("res_j", patch.res_j);
+    compute_shader->setInt("surface_start", patch.num_control_points());
+    compute_shader->setVec3("scale", 1.0f / patch.ni, 1.0f / patch.nj, 1.0f);
+    compute_shader->setVec3("offset", -0.5f, -0.5f, 0.0f);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, control_net_SSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, VBO);
+    glDispatchCompute_((patch.res_i + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE, (patch.res_j + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE, 1);
+    // the next draw reads the samples as vertex attributes
+    glMemoryBarrier_(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
 }
 
-void generate_points(unsigned int &VBO, int NUMI, int NUMJ)
+// reads the samples the compute shader wrote back and compares them with the cpu evaluator
+bool verify_compute_surface()
 {
-    int i, j, ki, kj;
-    float mui, muj, bi, bj;
-    srand(time(0));
-    for (i = 0; i <= NUMI; i++)
+    int surface_start = patch.num_control_points();
+    vector<float> gpu(patch.num_samples() * INFO_PER_POINT);
+    glMemoryBarrier_(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glGetBufferSubData(GL_ARRAY_BUFFER, surface_start * INFO_PER_POINT * sizeof(float), gpu.size() * sizeof(float), gpu.data());
+
+    patch.update_basis();
+    patch.evaluate();
+    float position_error = 0, normal_error = 0;
+    for (int i = 0; i < patch.res_i; i++)
     {
-        for (j = 0; j <= NUMJ; j++)
+        for (int j = 0; j < patch.res_j; j++)
         {
-            CP[i][j][0] = i;
-            CP[i][j][1] = j;
-            CP[i][j][2] = (rand() % 10000) / 10000.0;
+            const float *v = &gpu[(i * patch.res_j + j) * INFO_PER_POINT];
+            position_error = max(position_error, glm::distance(glm::vec3(v[0], v[1], v[2]), surface_vertex(i, j)));
+            normal_error = max(normal_error, glm::distance(glm::vec3(v[3], v[4], v[5]), surface_normal(i, j)));
         }
     }
-    for (i = 0; i <= NUMI; i++)
+    std::cout << "compute shader vs cpu over " << patch.res_i << "x" << patch.res_j << " samples: max position error " << position_error << ", max normal error " << normal_error << std::endl;
+    return position_error <= COMPUTE_VERIFY_TOLERANCE && normal_error <= COMPUTE_VERIFY_TOLERANCE;
+}
+
+// drags a control point in the middle of the net like the mouse would, then compares one
+// sample of the cpu surface with the surface of the drawn markers, evaluated on the cpu. the
+// tessellation shaders take the markers as their patch, so this catches a drag that moves the
+// markers and the patch apart, it does not run or read back the shaders themselves. the cpu
+// sample is the incrementally updated grid where the cpu keeps one, otherwise the patch
+// evaluated at that point
+bool check_drag_consistency()
+{
+    int ci = patch.ni / 2, cj = patch.nj / 2;
+    int marker = ci * (patch.nj + 1) + cj;
+    drag_control_point(marker, points.geometry[marker].position + glm::vec3(0.1f, -0.05f, 0.2f));
+
+    int i = patch.res_i / 2, j = patch.res_j / 3;
+    double u = double(i) / (patch.res_i - 1), v = double(j) / (patch.res_j - 1);
+    glm::vec3 cpu;
+    if (gpu_tessellation || gpu_compute || adaptive_tessellation)
+    {
+        float p[3];
+        patch.evaluate_point(u, v, p);
+        cpu = patch_to_marker(p);
+    }
+    else
+    {
+        cpu = surface_vertex(i, j);
+    }
+
+    vector<double> bu(patch.ni + 1), bv(patch.nj + 1);
+    bernstein_row(patch.ni, u, bu.data());
+    bernstein_row(patch.nj, v, bv.data());
+    glm::vec3 from_markers = glm::vec3(0.0f);
+    for (int k = 0; k <= patch.ni; k++)
+    {
+        for (int l = 0; l <= patch.nj; l++)
+        {
+            from_markers += float(bu[k] * bv[l]) * points.geometry[k * (patch.nj + 1) + l].position;
+        }
+    }
+
+    float error = glm::distance(cpu, from_markers);
+    std::cout << "drag of control point (" << ci << ", " << cj << "): patch vs markers at sample (" << i << ", " << j << ") differ by " << error << std::endl;
+    return error <= DRAG_CHECK_TOLERANCE;
+}
+
+void generate_points()
+{
+    int i, j;
+    random_control_net(patch, time(0));
+    for (i = 0; i <= patch.ni; i++)
     {
-        for (j = 0; j <= NUMJ; j++)
+        for (j = 0; j <= patch.nj; j++)
         {
-            points.add_point(VBO, Points::Point(glm::vec3(CP[i][j][0] / NUMI - 0.5f, CP[i][j][1] / NUMJ - 0.5f, CP[i][j][2]), true, i, j));
+            const float *cp = patch.control_point(i, j);
+            points.add_point(Points::Point(patch_to_marker(cp), true, i, j));
         }
     }
-    bezier_surface(VBO, NUMI, NUMJ);
+    bezier_surface();
 }
@@ -0,0 +1,442 @@
+// command to compile on my environment (linux mint):
+// make microbench.exec
+
+// execute:
+// ./microbench.exec [--filter TEXT] [--min-time SECONDS] [--json FILE]
+
+// microbenchmarks of the cpu side of the viewer: blend() and the basis tables, every
+// SurfacePatch evaluation mode at several degrees and resolutions, the incremental drag
+// update, the point pool and vertex serialization, index generation and adaptive
+// tessellation. works like google benchmark: a case loops while state.keep_running(), the
+// iteration count grows until one run takes at least --min-time, and --json writes the
+// results in google benchmark's json layout so its compare.py can diff two versions
+
+#include "./Points.cpp"
+#include "./Surface_patch.h"
+#include "./Surface_lod.h"
+#include "./Adaptive_tessellator.h"
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define DEFAULT_MIN_TIME 0.2
+#define MAX_ITERATIONS 1000000000L
+
+// keeps the compiler from dropping a computation whose result is never used
+template <typename T>
+inline void do_not_optimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchState
+{
+public:
+    long iterations;
+    // items one iteration processes, reported as items per second when set
+    long items_per_iteration;
+    double real_seconds, cpu_seconds;
+
+    BenchState(long iterations) : iterations(iterations), items_per_iteration(0), real_seconds(0), cpu_seconds(0), remaining(iterations) {}
+
+    // true while iterations are left. the clocks start at the first call, so the setup in
+    // front of the loop is not timed
+    bool keep_running()
+    {
+        if (this->remaining == this->iterations)
+        {
+            this->real_start = chrono::steady_clock::now();
+            this->cpu_start = clock();
+        }
+        if (this->remaining-- > 0)
+        {
+            return true;
+        }
+        this->real_seconds = chrono::duration<double>(chrono::steady_clock::now() - this->real_start).count();
+        this->cpu_seconds = double(clock() - this->cpu_start) / CLOCKS_PER_SEC;
+        return false;
+    }
+
+private:
+    long remaining;
+    chrono::steady_clock::time_point real_start;
+    clock_t cpu_start;
+};
+
+struct BenchCase
+{
+    string name;
+    function<void(BenchState &)> run;
+};
+
+struct BenchResult
+{
+    string name;
+    long iterations;
+    // nanoseconds per iteration
+    double real_time, cpu_time;
+    double items_per_second;
+};
+
+vector<BenchCase> cases;
+
+void add_case(const string &name, function<void(BenchState &)> run)
+{
+    cases.push_back({name, run});
+}
+
+// runs a case with more and more iterations until it takes at least min_time
+BenchResult run_case(const BenchCase &bench, double min_time)
+{
+    long iterations = 1;
+    while (true)
+    {
+        BenchState state(iterations);
+        bench.run(state);
+        if (state.real_seconds >= min_time || iterations >= MAX_ITERATIONS)
+        {
+            BenchResult result = {bench.name, iterations, state.real_seconds * 1e9 / iterations, state.cpu_seconds * 1e9 / iterations, 0};
+            if (state.items_per_iteration > 0)
+            {
+                result.items_per_second = state.items_per_iteration * iterations / state.real_seconds;
+            }
+            return result;
+        }
+        // aim a bit past min_time, growing at most 10x per step
+        double factor = state.real_seconds > 0 ? 1.4 * min_time / state.real_seconds : 10;
+        iterations = min(max(long(iterations * min(factor, 10.0)), iterations + 1), MAX_ITERATIONS);
+    }
+}
+
+const char *mode_name(EvaluationMode mode)
+{
+    switch (mode)
+    {
+    case EVAL_SIMD_BATCH:
+        return "simd";
+    case EVAL_FORWARD_DIFFERENCES:
+        return "fd";
+    case EVAL_DE_CASTELJAU:
+        return "casteljau";
+    default:
+        return "tables";
+    }
+}
+
+void register_evaluator_cases()
+{
+    for (int n : {3, 8, 20})
+    {
+        add_case("blend/" + to_string(n), [n](BenchState &state) {
+            float mu[16];
+            for (int m = 0; m < 16; m++)
+            {
+                mu[m] = m / 15.0f;
+            }
+            while (state.keep_running())
+            {
+                for (int m = 0; m < 16; m++)
+                {
+                    for (int k = 0; k <= n; k++)
+                    {
+                        do_not_optimize(blend(k, mu[m], n));
+                    }
+                }
+            }
+            state.items_per_iteration = 16 * (n + 1);
+        });
+    }
+
+    for (int n : {3, 8})
+    {
+        for (int res : {32, 256})
+        {
+            add_case("basis_table/" + to_string(n) + "/" + to_string(res), [n, res](BenchState &state) {
+                while (state.keep_running())
+                {
+                    BasisTable table;
+                    table.update(n, res);
+                    do_not_optimize(table.weights.data());
+                }
+                state.items_per_iteration = res * (n + 1);
+            });
+        }
+    }
+
+    // positions only, the derivatives are timed separately
+    EvaluationMode modes[] = {EVAL_BASIS_TABLES, EVAL_SIMD_BATCH, EVAL_FORWARD_DIFFERENCES, EVAL_DE_CASTELJAU};
+    for (EvaluationMode mode : modes)
+    {
+        for (int n : {3, 5, 8})
+        {
+            for (int res : {32, 100, 256})
+            {
+                string name = string("evaluate/") + mode_name(mode) + "/" + to_string(n) + "/" + to_string(res);
+                add_case(name, [mode, n, res](BenchState &state) {
+                    SurfacePatch patch(n, n, res, res);
+                    random_control_net(patch, 1);
+                    patch.mode = mode;
+                    patch.compute_derivatives = false;
+                    patch.evaluate();
+                    while (state.keep_running())
+                    {
+                        patch.evaluate();
+                        do_not_optimize(patch.samples()[0]);
+                    }
+                    state.items_per_iteration = patch.num_samples();
+                });
+            }
+        }
+    }
+
+    for (int res : {32, 100, 256})
+    {
+        add_case("evaluate_derivatives/tables/5/" + to_string(res), [res](BenchState &state) {
+            SurfacePatch patch(5, 5, res, res);
+            random_control_net(patch, 1);
+            patch.evaluate();
+            while (state.keep_running())
+            {
+                patch.evaluate();
+                do_not_optimize(patch.samples()[0]);
+            }
+            state.items_per_iteration = patch.num_samples();
+        });
+    }
+
+    for (int res : {32, 100, 256})
+    {
+        for (bool derivatives : {true, false})
+        {
+            // one step of dragging an inner control point, compare with evaluate_derivatives and
+            // evaluate/tables respectively
+            string name = string(derivatives ? "apply_delta/5/" : "apply_delta_positions/5/") + to_string(res);
+            add_case(name, [res, derivatives](BenchState &state) {
+                SurfacePatch patch(5, 5, res, res);
+                random_control_net(patch, 1);
+                patch.compute_derivatives = derivatives;
+                patch.evaluate();
+                float delta[2][3] = {{0.01f, 0.0f, 0.02f}, {-0.01f, 0.0f, -0.02f}};
+                int i_min, i_max, j_min, j_max;
+                long step = 0;
+                while (state.keep_running())
+                {
+                    patch.apply_delta(2, 3, delta[step++ & 1], i_min, i_max, j_min, j_max);
+                    do_not_optimize(patch.samples()[0]);
+                }
+                state.items_per_iteration = patch.num_samples();
+            });
+        }
+    }
+}
+
+void register_vertex_cases()
+{
+    for (int count : {1024, 65536})
+    {
+        // emitting the vertices of a surface into the pool, as bezier_surface() does
+        add_case("add_point/" + to_string(count), [count](BenchState &state) {
+            Points pool;
+            pool.reserve(count);
+            vector<Points::Point> input;
+            for (int k = 0; k < count; k++)
+            {
+                input.push_back(Points::Point(glm::vec3(k, k + 1, k + 2), glm::vec3(0, 0, 1), glm::vec2(k, k)));
+            }
+            while (state.keep_running())
+            {
+                Points::num_points = 0;
+                pool.dirty_first = pool.dirty_last = 0;
+                for (const Points::Point &point : input)
+                {
+                    pool.add_point(point);
+                }
+                do_not_optimize(pool.geometry.data());
+            }
+            state.items_per_iteration = count;
+        });
+
+        for (VertexFormat format : {VERTEX_FLOAT, VERTEX_COMPACT})
+        {
+            // serialized and copied to memory standing in for the mapped stream segment, for
+            // float vertices that copy is all there is
+            string name = string("serialize/") + (format == VERTEX_FLOAT ? "float/" : "compact/") + to_string(count);
+            add_case(name, [format, count](BenchState &state) {
+                Points pool;
+                pool.format = format;
+                Points::num_points = 0;
+                for (int k = 0; k < count; k++)
+                {
+                    float t = float(k) / count;
+                    pool.add_point(Points::Point(glm::vec3(t, 1 - t, t * t), glm::normalize(glm::vec3(t, 1, 1 - t)), glm::vec2(2 * k - 1, k)));
+                }
+                vector<unsigned char> mapped(count * pool.vertex_size());
+                while (state.keep_running())
+                {
+                    memcpy(mapped.data(), pool.serialize_points(0, count), mapped.size());
+                    do_not_optimize(mapped.data());
+                }
+                state.items_per_iteration = count;
+            });
+        }
+    }
+}
+
+void register_index_cases()
+{
+    for (int res : {100, 512})
+    {
+        for (bool strips : {false, true})
+        {
+            string name = string("lod_build/") + (strips ? "strips/" : "triangles/") + to_string(res);
+            add_case(name, [res, strips](BenchState &state) {
+                SurfaceLod lod;
+                while (state.keep_running())
+                {
+                    lod.build(res, res, 0, strips);
+                    do_not_optimize(lod.indices.data());
+                }
+                state.items_per_iteration = (res - 1) * (res - 1);
+            });
+        }
+
+        add_case("lod_errors/5/" + to_string(res), [res](BenchState &state) {
+            SurfacePatch patch(5, 5, res, res);
+            random_control_net(patch, 1);
+            patch.evaluate();
+            SurfaceLod lod;
+            lod.build(res, res, 0, false);
+            float scale[3] = {1.0f / 5, 1.0f / 5, 1.0f}, offset[3] = {-0.5f, -0.5f, 0.0f};
+            while (state.keep_running())
+            {
+                lod.update_errors(patch.samples(), scale, offset);
+                do_not_optimize(lod.levels[1].error);
+            }
+            state.items_per_iteration = patch.num_samples();
+        });
+    }
+
+    for (float tolerance : {0.01f, 0.001f})
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "adaptive/5/%g", tolerance);
+        add_case(name, [tolerance](BenchState &state) {
+            SurfacePatch patch(5, 5, 2, 2);
+            random_control_net(patch, 1);
+            AdaptiveTessellator tessellator(tolerance);
+            AdaptiveMesh mesh;
+            while (state.keep_running())
+            {
+                tessellator.tessellate(patch, mesh);
+                do_not_optimize(mesh.indices.data());
+            }
+            state.items_per_iteration = mesh.indices.size() / 3;
+        });
+    }
+}
+
+bool write_json(const char *path, const vector<BenchResult> &results)
+{
+    FILE *file = fopen(path, "w");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "can not write %s\n", path);
+        return false;
+    }
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    const char *simd = nullptr;
+    select_batch_evaluator(&simd);
+
+    fprintf(file, "{\n  \"context\": {\n");
+    fprintf(file, "    \"date\": \"%s\",\n", date);
+    fprintf(file, "    \"executable\": \"microbench.exec\",\n");
+    fprintf(file, "    \"num_cpus\": %u,\n", thread::hardware_concurrency());
+    fprintf(file, "    \"simd_evaluator\": \"%s\"\n", simd);
+    fprintf(file, "  },\n  \"benchmarks\": [\n");
+    for (size_t r = 0; r < results.size(); r++)
+    {
+        const BenchResult &result = results[r];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", result.name.c_str());
+        fprintf(file, "      \"run_name\": \"%s\",\n", result.name.c_str());
+        fprintf(file, "      \"run_type\": \"iteration\",\n");
+        fprintf(file, "      \"iterations\": %ld,\n", result.iterations);
+        fprintf(file, "      \"real_time\": %.6g,\n", result.real_time);
+        fprintf(file, "      \"cpu_time\": %.6g,\n", result.cpu_time);
+        fprintf(file, "      \"time_unit\": \"ns\"");
+        if (result.items_per_second > 0)
+        {
+            fprintf(file, ",\n      \"items_per_second\": %.6g", result.items_per_second);
+        }
+        fprintf(file, "\n    }%s\n", r + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = "";
+    const char *json_path = nullptr;
+    double min_time = DEFAULT_MIN_TIME;
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "--filter") == 0 && a + 1 < argc)
+        {
+            filter = argv[++a];
+        }
+        else if (strcmp(argv[a], "--min-time") == 0 && a + 1 < argc)
+        {
+            min_time = atof(argv[++a]);
+        }
+        else if (strcmp(argv[a], "--json") == 0 && a + 1 < argc)
+        {
+            json_path = argv[++a];
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--filter TEXT] [--min-time SECONDS] [--json FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    register_evaluator_cases();
+    register_vertex_cases();
+    register_index_cases();
+
+    vector<BenchResult> results;
+    printf("%-36s %14s %14s %12s %14s\n", "benchmark", "time", "cpu", "iterations", "items/s");
+    for (const BenchCase &bench : cases)
+    {
+        if (bench.name.find(filter) == string::npos)
+        {
+            continue;
+        }
+        BenchResult result = run_case(bench, min_time);
+        printf("%-36s %11.1f ns %11.1f ns %12ld", result.name.c_str(), result.real_time, result.cpu_time, result.iterations);
+        if (result.items_per_second > 0)
+        {
+            printf(" %12.4gM", result.items_per_second / 1e6);
+        }
+        printf("\n");
+        fflush(stdout);
+        results.push_back(result);
+    }
+
+    if (json_path != nullptr && !write_json(json_path, results))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,424 @@
+// command to compile on my environment (linux mint):
+// make tessellate.exec
+
+// execute:
+// ./tessellate.exec [--res RES_I RES_J] [--threads N] [--mode tables|simd|fd|casteljau] [--format obj|ply|stl] INPUT OUTPUT
+
+// tessellates every patch of a control net file without a window or a gpu, with the same
+// SurfacePatch evaluator bezier_surface() uses, and streams the mesh out patch by patch.
+// the input is text, '#' starts a comment, and holds any number of patches as
+//
+//     NI NJ
+//     x y z       (NI + 1) * (NJ + 1) control points, row i = 0 first, j runs fastest
+//     ...
+//
+// all patches go into one mesh in patch space. obj and ply are written with normals, stl
+// carries per-facet normals only. ply stores every vertex before the first face, its faces
+// only depend on the resolution and are generated after the last patch, so no format keeps
+// more than one patch in memory
+
+#include "./Surface_patch.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define DEFAULT_RES 32
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+enum MeshFormat
+{
+    MESH_OBJ,
+    MESH_PLY,
+    MESH_STL
+};
+
+struct ControlNet
+{
+    int ni, nj;
+    vector<float> points;
+};
+
+bool read_control_nets(const char *path, vector<ControlNet> &nets)
+{
+    ifstream file(path);
+    if (!file)
+    {
+        cerr << "can not open " << path << endl;
+        return false;
+    }
+    // drop comments, then read the numbers
+    stringstream numbers;
+    string line;
+    while (getline(file, line))
+    {
+        numbers << line.substr(0, line.find('#')) << '\n';
+    }
+
+    ControlNet net;
+    while (numbers >> net.ni)
+    {
+        if (!(numbers >> net.nj))
+        {
+            cerr << "patch " << nets.size() << ": expected the degrees NI NJ" << endl;
+            return false;
+        }
+        if (net.ni < 1 || net.nj < 1)
+        {
+            cerr << "patch " << nets.size() << ": degrees must be at least 1" << endl;
+            return false;
+        }
+        net.points.resize((net.ni + 1) * (net.nj + 1) * 3);
+        for (float &c : net.points)
+        {
+            if (!(numbers >> c))
+            {
+                cerr << "patch " << nets.size() << ": expected " << net.points.size() / 3 << " control points" << endl;
+                return false;
+            }
+        }
+        nets.push_back(net);
+    }
+    if (!numbers.eof())
+    {
+        cerr << "unexpected text after patch " << nets.size() << endl;
+        return false;
+    }
+    return true;
+}
+
+// unit normal at sample (i, j) in patch space from the partial derivatives, central
+// differences of the neighbouring samples where the patch is degenerate
+void sample_normal(SurfacePatch &patch, int i, int j, float *normal)
+{
+    const float *du = patch.sample_du(i, j);
+    const float *dv = patch.sample_dv(i, j);
+    float n[3] = {du[1] * dv[2] - du[2] * dv[1], du[2] * dv[0] - du[0] * dv[2], du[0] * dv[1] - du[1] * dv[0]};
+    float length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length < 1e-12f)
+    {
+        const float *u0 = patch.sample(max(i - 1, 0), j), *u1 = patch.sample(min(i + 1, patch.res_i - 1), j);
+        const float *v0 = patch.sample(i, max(j - 1, 0)), *v1 = patch.sample(i, min(j + 1, patch.res_j - 1));
+        float a[3] = {u1[0] - u0[0], u1[1] - u0[1], u1[2] - u0[2]};
+        float b[3] = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+        n[0] = a[1] * b[2] - a[2] * b[1];
+        n[1] = a[2] * b[0] - a[0] * b[2];
+        n[2] = a[0] * b[1] - a[1] * b[0];
+        length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    }
+    for (int k = 0; k < 3; k++)
+    {
+        normal[k] = length > 0 ? n[k] / length : 0.0f;
+    }
+}
+
+// the two triangles of cell (i, j), wound like build_surface_indices() in the viewer
+void cell_triangles(int i, int j, int res_j, unsigned int triangles[2][3])
+{
+    unsigned int a = i * res_j + j;
+    unsigned int b = a + 1;
+    unsigned int c = a + res_j;
+    unsigned int d = c + 1;
+    unsigned int t[2][3] = {{a, c, d}, {a, d, b}};
+    for (int k = 0; k < 2; k++)
+    {
+        for (int v = 0; v < 3; v++)
+        {
+            triangles[k][v] = t[k][v];
+        }
+    }
+}
+
+// false if not all of out reached the file
+bool write_out(FILE *file, const vector<char> &out)
+{
+    return fwrite(out.data(), 1, out.size(), file) == out.size();
+}
+
+template <typename T>
+void put(vector<char> &out, T value)
+{
+    const char *bytes = (const char *)&value;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void write_header(FILE *file, MeshFormat format, long vertices, long triangles)
+{
+    if (format == MESH_PLY)
+    {
+        fprintf(file, "ply\nformat binary_little_endian 1.0\nelement vertex %ld\n", vertices);
+        fprintf(file, "property float x\nproperty float y\nproperty float z\n");
+        fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+        fprintf(file, "element face %ld\nproperty list uchar int vertex_indices\nend_header\n", triangles);
+    }
+    else if (format == MESH_STL)
+    {
+        char header[80] = "binary stl written by tessellate";
+        fwrite(header, 1, sizeof(header), file);
+        uint32_t count = triangles;
+        fwrite(&count, sizeof(count), 1, file);
+    }
+}
+
+// faces of a ply patch, which only depend on the resolution and go after all vertices
+void write_ply_faces(int res_i, int res_j, long first_vertex, vector<char> &out)
+{
+    unsigned int triangles[2][3];
+    for (int i = 0; i < res_i - 1; i++)
+    {
+        for (int j = 0; j < res_j - 1; j++)
+        {
+            cell_triangles(i, j, res_j, triangles);
+            for (auto &t : triangles)
+            {
+                put(out, (uint8_t)3);
+                for (int v = 0; v < 3; v++)
+                    put(out, (int32_t)(first_vertex + t[v]));
+            }
+        }
+    }
+}
+
+// vertices and faces of one patch, ply patches only write their vertices here
+void write_patch(SurfacePatch &patch, MeshFormat format, long first_vertex, vector<char> &out)
+{
+    int res_i = patch.res_i, res_j = patch.res_j;
+    char line[128];
+    float normal[3];
+
+    if (format != MESH_STL)
+    {
+        for (int i = 0; i < res_i; i++)
+        {
+            for (int j = 0; j < res_j; j++)
+            {
+                const float *p = patch.sample(i, j);
+                sample_normal(patch, i, j, normal);
+                if (format == MESH_OBJ)
+                {
+                    int n = snprintf(line, sizeof(line), "v %.7g %.7g %.7g\nvn %.5g %.5g %.5g\n", p[0], p[1], p[2], normal[0], normal[1], normal[2]);
+                    out.insert(out.end(), line, line + n);
+                }
+                else
+                {
+                    for (int k = 0; k < 3; k++)
+                        put(out, p[k]);
+                    for (int k = 0; k < 3; k++)
+                        put(out, normal[k]);
+                }
+            }
+        }
+    }
+
+    if (format == MESH_PLY)
+    {
+        return;
+    }
+    unsigned int triangles[2][3];
+    for (int i = 0; i < res_i - 1; i++)
+    {
+        for (int j = 0; j < res_j - 1; j++)
+        {
+            cell_triangles(i, j, res_j, triangles);
+            for (auto &t : triangles)
+            {
+                if (format == MESH_OBJ)
+                {
+                    // obj indices are global and start at 1
+                    long a = first_vertex + t[0] + 1, b = first_vertex + t[1] + 1, c = first_vertex + t[2] + 1;
+                    int n = snprintf(line, sizeof(line), "f %ld//%ld %ld//%ld %ld//%ld\n", a, a, b, b, c, c);
+                    out.insert(out.end(), line, line + n);
+                }
+                else
+                {
+                    const float *p0 = patch.sample(t[0] / res_j, t[0] % res_j);
+                    const float *p1 = patch.sample(t[1] / res_j, t[1] % res_j);
+                    const float *p2 = patch.sample(t[2] / res_j, t[2] % res_j);
+                    float a[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                    float b[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+                    float n[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+                    float length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    for (int k = 0; k < 3; k++)
+                        put(out, length > 0 ? n[k] / length : 0.0f);
+                    for (const float *p : {p0, p1, p2})
+                        for (int k = 0; k < 3; k++)
+                            put(out, p[k]);
+                    put(out, (uint16_t)0);
+                }
+            }
+        }
+    }
+}
+
+bool parse_format(const string &name, MeshFormat &format)
+{
+    if (name == "obj")
+        format = MESH_OBJ;
+    else if (name == "ply")
+        format = MESH_PLY;
+    else if (name == "stl")
+        format = MESH_STL;
+    else
+        return false;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int res_i = DEFAULT_RES, res_j = DEFAULT_RES, num_threads = 1;
+    EvaluationMode mode = EVAL_BASIS_TABLES;
+    string format_name;
+    vector<const char *> paths;
+
+    for (int a = 1; a < argc; a++)
+    {
+        string arg = argv[a];
+        if (arg == "--res" && a + 2 < argc)
+        {
+            res_i = atoi(argv[++a]);
+            res_j = atoi(argv[++a]);
+        }
+        else if (arg == "--threads" && a + 1 < argc)
+        {
+            num_threads = atoi(argv[++a]);
+        }
+        else if (arg == "--format" && a + 1 < argc)
+        {
+            format_name = argv[++a];
+        }
+        else if (arg == "--mode" && a + 1 < argc)
+        {
+            string name = argv[++a];
+            if (name == "tables")
+                mode = EVAL_BASIS_TABLES;
+            else if (name == "simd")
+                mode = EVAL_SIMD_BATCH;
+            else if (name == "fd")
+                mode = EVAL_FORWARD_DIFFERENCES;
+            else if (name == "casteljau")
+                mode = EVAL_DE_CASTELJAU;
+            else
+            {
+                cerr << "unknown evaluation mode " << name << endl;
+                return 1;
+            }
+        }
+        else
+        {
+            paths.push_back(argv[a]);
+        }
+    }
+    if (paths.size() != 2 || res_i < 2 || res_j < 2)
+    {
+        cerr << "usage: " << argv[0] << " [--res RES_I RES_J] [--threads N] [--mode tables|simd|fd|casteljau] [--format obj|ply|stl] INPUT OUTPUT" << endl;
+        return 1;
+    }
+
+    // without --format the extension of the output decides
+    if (format_name.empty())
+    {
+        string output = paths[1];
+        format_name = output.substr(output.find_last_of('.') + 1);
+    }
+    MeshFormat format;
+    if (!parse_format(format_name, format))
+    {
+        cerr << "unknown mesh format " << format_name << ", use obj, ply or stl" << endl;
+        return 1;
+    }
+
+    vector<ControlNet> nets;
+    if (!read_control_nets(paths[0], nets))
+    {
+        return 1;
+    }
+    if (nets.empty())
+    {
+        cerr << paths[0] << " holds no patches" << endl;
+        return 1;
+    }
+
+    FILE *file = fopen(paths[1], "wb");
+    if (file == nullptr)
+    {
+        cerr << "can not write " << paths[1] << endl;
+        return 1;
+    }
+    setvbuf(file, nullptr, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    long vertices_per_patch = (long)res_i * res_j;
+    long triangles_per_patch = 2L * (res_i - 1) * (res_j - 1);
+    write_header(file, format, vertices_per_patch * nets.size(), triangles_per_patch * nets.size());
+
+    SurfacePatch patch(nets[0].ni, nets[0].nj, res_i, res_j);
+    patch.mode = mode;
+    patch.de_casteljau_double = true;
+    patch.set_num_threads(num_threads);
+
+    vector<char> out;
+    double evaluate_seconds = 0;
+    auto start = chrono::steady_clock::now();
+    for (size_t p = 0; p < nets.size(); p++)
+    {
+        const ControlNet &net = nets[p];
+        if (net.ni != patch.ni || net.nj != patch.nj)
+        {
+            patch.resize(net.ni, net.nj, res_i, res_j);
+        }
+        for (int i = 0; i <= net.ni; i++)
+        {
+            for (int j = 0; j <= net.nj; j++)
+            {
+                float *cp = patch.control_point(i, j);
+                for (int k = 0; k < 3; k++)
+                {
+                    cp[k] = net.points[(i * (net.nj + 1) + j) * 3 + k];
+                }
+            }
+        }
+
+        auto evaluate_start = chrono::steady_clock::now();
+        patch.update_basis();
+        patch.evaluate();
+        evaluate_seconds += chrono::duration<double>(chrono::steady_clock::now() - evaluate_start).count();
+
+        out.clear();
+        write_patch(patch, format, p * vertices_per_patch, out);
+        if (!write_out(file, out))
+        {
+            break;
+        }
+    }
+    if (format == MESH_PLY)
+    {
+        for (size_t p = 0; p < nets.size() && !ferror(file); p++)
+        {
+            out.clear();
+            write_ply_faces(res_i, res_j, p * vertices_per_patch, out);
+            write_out(file, out);
+        }
+    }
+    // the header and every patch went through the stream, a full disk shows up here or when
+    // the buffer is flushed on close
+    bool write_failed = ferror(file) != 0;
+    if (fclose(file) != 0 || write_failed)
+    {
+        cerr << "writing " << paths[1] << " failed" << endl;
+        return 1;
+    }
+    double total_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    long triangles = triangles_per_patch * nets.size();
+    fprintf(stderr, "%zu patches, %ld triangles at %dx%d\n", nets.size(), triangles, res_i, res_j);
+    fprintf(stderr, "evaluation: %.3f s, %.1f patches/s, %.0f triangles/s\n", evaluate_seconds, nets.size() / evaluate_seconds, triangles / evaluate_seconds);
+    fprintf(stderr, "with output: %.3f s, %.1f patches/s, %.0f triangles/s\n", total_seconds, nets.size() / total_seconds, triangles / total_seconds);
+    return 0;
+}